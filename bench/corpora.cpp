@@ -0,0 +1,249 @@
+#include "corpora.hpp"
+
+#include "grammar.hpp"
+#include "reader.hpp"
+
+#include <array>
+#include <cstdint>
+#include <random>
+
+namespace
+{
+
+// Sizes growing by 16 times from 4 KB up to largest.
+auto Growing(std::size_t largest) -> std::vector<std::size_t>
+{
+    std::vector<std::size_t> sizes;
+    for (std::size_t size = 4096; size <= largest; size *= 16)
+    {
+        sizes.push_back(size);
+    }
+    return sizes;
+}
+
+// Picks pseudo-random numbers from a fixed seed so inputs are reproducible.
+class Random
+{
+  public:
+    explicit Random(std::size_t seed) : engine{static_cast<std::uint32_t>(seed)} {}
+
+    auto Below(std::size_t bound) -> std::size_t
+    {
+        return std::uniform_int_distribution<std::size_t>{0, bound - 1}(engine);
+    }
+
+    auto Word(std::size_t length) -> std::string
+    {
+        std::string word;
+        for (std::size_t i = 0; i < length; i++)
+        {
+            word += static_cast<char>('a' + Below(26));
+        }
+        return word;
+    }
+
+  private:
+    std::mt19937 engine;
+};
+
+constexpr const char *Arithmetic = R"(
+Expression <- Spacing Sum EndOfFile
+Sum        <- Product (("+" / "-") Spacing Product)*
+Product    <- Value (("*" / "/") Spacing Value)*
+Value      <- Number / '(' Spacing Sum ')' Spacing
+Number     <- [0-9]+ Spacing
+Spacing    <- [ \t\n]*
+EndOfFile  <- !.
+)";
+
+constexpr const char *Json = R"(
+Json      <- Spacing Value EndOfFile
+Value     <- (Object / Array / String / Number / 'true' / 'false' / 'null') Spacing
+Object    <- '{' Spacing (Member (',' Spacing Member)*)? '}'
+Member    <- String Spacing ':' Spacing Value
+Array     <- '[' Spacing (Value (',' Spacing Value)*)? ']'
+String    <- '"' ('\\' . / !'"' .)* '"'
+Number    <- '-'? [0-9]+ ('.' [0-9]+)? ([eE] [+\-]? [0-9]+)?
+Spacing   <- [ \t\r\n]*
+EndOfFile <- !.
+)";
+
+constexpr const char *Csv = R"(
+File      <- Row* EndOfFile
+Row       <- Field (',' Field)* '\r'? '\n'
+Field     <- '"' ('""' / !'"' .)* '"' / (![,\r\n] .)*
+EndOfFile <- !.
+)";
+
+constexpr const char *Log = R"(
+Log       <- Line* EndOfFile
+Line      <- Timestamp ' ' Level ' ' Source ' ' Message '\n'
+Timestamp <- Digit Digit Digit Digit '-' Digit Digit '-' Digit Digit 'T'
+             Digit Digit ':' Digit Digit ':' Digit Digit 'Z'
+Level     <- 'DEBUG' / 'INFO' / 'WARN' / 'ERROR'
+Source    <- '[' [a-z0-9\-]+ ']'
+Message   <- (Pair / Word) (' ' (Pair / Word))*
+Pair      <- Word '=' Value
+Value     <- [0-9]+ 'ms' / [0-9]+ / Word
+Word      <- [a-zA-Z0-9_./]+
+Digit     <- [0-9]
+EndOfFile <- !.
+)";
+
+// Without memoization every level parses its subtree twice, so time doubles with
+// each extra level.
+constexpr const char *Backtracking = R"(
+Nested <- 'a' Nested 'b' / 'a' Nested 'c' / 'a'
+)";
+
+auto Expression(Random &random, std::size_t depth) -> std::string
+{
+    std::string text;
+    const std::size_t terms = 1 + random.Below(4);
+    for (std::size_t i = 0; i < terms; i++)
+    {
+        if (i > 0)
+        {
+            text += " +-*/"[1 + random.Below(4)];
+            text += ' ';
+        }
+        if (depth > 0 && random.Below(3) == 0)
+        {
+            text += "(" + Expression(random, depth - 1) + ") ";
+        }
+        else
+        {
+            text += std::to_string(random.Below(100000)) + " ";
+        }
+    }
+    return text;
+}
+
+auto JsonValue(Random &random, std::size_t depth) -> std::string
+{
+    switch (depth == 0 ? 2 + random.Below(3) : random.Below(5))
+    {
+    case 0:
+    {
+        std::string text = "{";
+        const std::size_t members = 1 + random.Below(5);
+        for (std::size_t i = 0; i < members; i++)
+        {
+            text += (i > 0 ? ", \"" : "\"") + random.Word(1 + random.Below(8)) +
+                    "\": " + JsonValue(random, depth - 1);
+        }
+        return text + "}";
+    }
+    case 1:
+    {
+        std::string text = "[";
+        const std::size_t values = random.Below(6);
+        for (std::size_t i = 0; i < values; i++)
+        {
+            text += (i > 0 ? ", " : "") + JsonValue(random, depth - 1);
+        }
+        return text + "]";
+    }
+    case 2:
+        return "\"" + random.Word(random.Below(16)) + "\\n\"";
+    case 3:
+        return "-" + std::to_string(random.Below(1000000)) + ".25e+3";
+    default:
+        return random.Below(2) == 0 ? "true" : "null";
+    }
+}
+
+// Grammar rules with every kind of expression, each referring to an earlier rule.
+auto PegInput(std::size_t size) -> std::string
+{
+    Random random{size};
+    std::string text;
+    for (std::size_t i = 0; text.size() < size; i++)
+    {
+        text += "Rule" + std::to_string(i) + " <- '" + random.Word(4) +
+                "' / [a-z]+ Rule" + std::to_string(random.Below(i + 1)) +
+                "* (\"x\" / !'y' .)? # note\n";
+    }
+    return text;
+}
+
+auto ArithmeticInput(std::size_t size) -> std::string
+{
+    Random random{size};
+    std::string text = Expression(random, 6);
+    while (text.size() < size)
+    {
+        text += "+ " + Expression(random, 6);
+    }
+    return text;
+}
+
+auto JsonInput(std::size_t size) -> std::string
+{
+    Random random{size};
+    std::string text = "[";
+    while (text.size() < size)
+    {
+        text += (text.size() > 1 ? ",\n" : "") + JsonValue(random, 4);
+    }
+    return text + "]";
+}
+
+auto CsvInput(std::size_t size) -> std::string
+{
+    Random random{size};
+    std::string text;
+    while (text.size() < size)
+    {
+        text += std::to_string(random.Below(100000)) + "," + random.Word(8) + ",\"" +
+                random.Word(4) + ", \"\"quoted\"\"\"," + random.Word(12) + "\n";
+    }
+    return text;
+}
+
+auto LogInput(std::size_t size) -> std::string
+{
+    static const std::array<const char *, 4> levels = {"DEBUG", "INFO", "WARN", "ERROR"};
+    Random random{size};
+    std::string text;
+    while (text.size() < size)
+    {
+        text += "2024-01-0" + std::to_string(1 + random.Below(9)) + "T12:34:56Z " +
+                levels.at(random.Below(levels.size())) + " [worker-" +
+                std::to_string(random.Below(16)) + "] request id=" +
+                std::to_string(random.Below(99999)) + " path=/" + random.Word(6) +
+                " took " + std::to_string(random.Below(500)) + "ms\n";
+    }
+    return text;
+}
+
+// Each level of nesting fails on 'b' before matching 'c'.
+auto BacktrackingInput(std::size_t size) -> std::string
+{
+    const std::size_t depth = (size + 1) / 2;
+    return std::string(depth, 'a') + std::string(depth - 1, 'c');
+}
+
+// Exponential inputs stay small whatever the largest size.
+auto BacktrackingSizes(std::size_t /*largest*/) -> std::vector<std::size_t>
+{
+    return {15, 23, 31, 39};
+}
+
+} // namespace
+
+auto Corpora() -> std::vector<Corpus>
+{
+    return {
+        {"peg", GetPegGrammarAST(), "Grammar", PegInput, Growing},
+        {"arithmetic", ReadGrammar(Arithmetic), "Expression", ArithmeticInput, Growing},
+        {"json", ReadGrammar(Json), "Json", JsonInput, Growing},
+        {"csv", ReadGrammar(Csv), "File", CsvInput, Growing},
+        {"log", ReadGrammar(Log), "Log", LogInput, Growing},
+        {"backtracking",
+         ReadGrammar(Backtracking),
+         "Nested",
+         BacktrackingInput,
+         BacktrackingSizes},
+    };
+}
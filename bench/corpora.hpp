@@ -0,0 +1,24 @@
+#pragma once
+
+#include "ast.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A grammar and a generator of inputs for it.
+struct Corpus
+{
+    std::string name;
+    ast::Grammar grammar;
+    // The rule that matches a whole input.
+    std::string rule;
+    // Returns a valid input of roughly size bytes. The same size always gives the
+    // same input.
+    std::function<std::string(std::size_t size)> generate;
+    // Input sizes to measure, in bytes, given the largest size wanted.
+    std::function<std::vector<std::size_t>(std::size_t largest)> sizes;
+};
+
+auto Corpora() -> std::vector<Corpus>;
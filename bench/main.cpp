@@ -0,0 +1,203 @@
+#include "corpora.hpp"
+#include "measure.hpp"
+
+#include "generator.hpp"
+#include "vm.hpp"
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+
+namespace
+{
+
+// Parses an input with one of the engines and returns the end of the match.
+using Engine = std::function<std::optional<std::size_t>(std::string_view)>;
+
+struct Settings
+{
+    std::size_t largest = 1 << 20;
+    double min_time = 0.2;
+    bool counters = false;
+    std::string corpus;
+    std::string engine;
+};
+
+auto Engines(const Corpus &corpus) -> std::map<std::string, Engine>
+{
+    const auto end = [](const Result &result) -> std::optional<std::size_t>
+    {
+        if (const auto *success = std::get_if<Success>(&result))
+        {
+            return success->position;
+        }
+        return std::nullopt;
+    };
+    const auto parser = [&corpus, end](const Options &options) -> Engine
+    {
+        auto collection =
+            std::make_shared<Collection>(Generate(corpus.grammar, options));
+        auto context = std::make_shared<Context>();
+        return [collection, context, rule = corpus.rule, end](std::string_view input)
+        { return end(collection->Parse(rule, input, *context)); };
+    };
+    auto recognizer = std::make_shared<Collection>(Generate(corpus.grammar));
+    auto program = std::make_shared<vm::Program>(vm::Compile(corpus.grammar));
+
+    std::map<std::string, Engine> engines;
+    engines["closure"] = parser(Options{});
+    engines["packrat"] = parser(Options{.packrat = true});
+    engines["match"] = [recognizer, context = std::make_shared<Context>(),
+                        rule = corpus.rule](std::string_view input)
+    { return recognizer->Match(rule, input, *context); };
+    engines["vm"] = [program, rule = corpus.rule, end](std::string_view input)
+    { return end(program->Parse(rule, input)); };
+    return engines;
+}
+
+void Measure(const std::string &corpus,
+             const std::string &name,
+             const Engine &engine,
+             const std::string &input,
+             const Settings &settings,
+             bool first)
+{
+    using Clock = std::chrono::steady_clock;
+
+    // The first run warms up caches and memo tables; the second counts allocations.
+    engine(input);
+    ResetPeakResident();
+    ResetAllocations();
+    const auto end = engine(input);
+    const Allocations allocations = ReadAllocations();
+    const std::size_t resident = PeakResident();
+
+    double best = std::numeric_limits<double>::max();
+    double total = 0;
+    std::size_t runs = 0;
+    while (total < settings.min_time || runs == 0)
+    {
+        const auto start = Clock::now();
+        engine(input);
+        const std::chrono::duration<double> seconds = Clock::now() - start;
+        best = std::min(best, seconds.count());
+        total += seconds.count();
+        runs++;
+    }
+
+    std::optional<CounterValues> counters;
+    if (settings.counters)
+    {
+        HardwareCounters hardware;
+        hardware.Start();
+        engine(input);
+        counters = hardware.Stop();
+    }
+
+    const double bytes = static_cast<double>(input.size());
+    std::cout << (first ? "  " : ", ") << "{\"corpus\": \"" << corpus
+              << "\", \"engine\": \"" << name << "\", \"bytes\": " << input.size()
+              << ", \"matched\": " << (end == input.size() ? "true" : "false")
+              << ", \"runs\": " << runs << ", \"best_seconds\": " << best
+              << ", \"mean_seconds\": " << total / static_cast<double>(runs)
+              << ", \"mb_per_second\": " << bytes / best / 1e6
+              << ", \"allocations\": " << allocations.count
+              << ", \"allocated_bytes\": " << allocations.bytes
+              << ", \"allocations_per_byte\": "
+              << static_cast<double>(allocations.count) / std::max(bytes, 1.0)
+              << ", \"peak_heap_bytes\": " << allocations.peak
+              << ", \"peak_resident_bytes\": " << resident << ", \"counters\": ";
+    if (counters)
+    {
+        std::cout << "{\"cycles\": " << counters->cycles
+                  << ", \"cache_misses\": " << counters->cache_misses
+                  << ", \"branch_misses\": " << counters->branch_misses << "}";
+    }
+    else
+    {
+        std::cout << "null";
+    }
+    std::cout << "}" << std::endl;
+}
+
+void Usage(const char *program)
+{
+    std::cerr << "Usage: " << program
+              << " [--max-size BYTES] [--min-time SECONDS] [--counters]"
+                 " [--corpus NAME] [--engine NAME]"
+              << std::endl;
+}
+
+} // namespace
+
+// Measures every engine on every corpus at increasing input sizes and writes the
+// results to standard output as a JSON array, one object per measurement.
+auto main(int argc, char **argv) -> int
+{
+    Settings settings;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string argument = argv[i];
+        const bool value = i + 1 < argc;
+        if (argument == "--counters")
+        {
+            settings.counters = true;
+        }
+        else if (argument == "--max-size" && value)
+        {
+            settings.largest = std::stoul(argv[++i]);
+        }
+        else if (argument == "--min-time" && value)
+        {
+            settings.min_time = std::stod(argv[++i]);
+        }
+        else if (argument == "--corpus" && value)
+        {
+            settings.corpus = argv[++i];
+        }
+        else if (argument == "--engine" && value)
+        {
+            settings.engine = argv[++i];
+        }
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (settings.counters && !HardwareCounters{}.Available())
+    {
+        std::cerr << "Hardware counters are unavailable, reporting them as null"
+                  << std::endl;
+    }
+
+    bool first = true;
+    std::cout << "[" << std::endl;
+    for (const auto &corpus : Corpora())
+    {
+        if (!settings.corpus.empty() && corpus.name != settings.corpus)
+        {
+            continue;
+        }
+        const auto engines = Engines(corpus);
+        for (const std::size_t size : corpus.sizes(settings.largest))
+        {
+            const std::string input = corpus.generate(size);
+            for (const auto &[name, engine] : engines)
+            {
+                if (!settings.engine.empty() && name != settings.engine)
+                {
+                    continue;
+                }
+                Measure(corpus.name, name, engine, input, settings, first);
+                first = false;
+            }
+        }
+    }
+    std::cout << "]" << std::endl;
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include "measure.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+
+#include <linux/perf_event.h>
+#include <malloc.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+
+std::atomic<std::size_t> count{0};
+std::atomic<std::size_t> bytes{0};
+std::atomic<std::size_t> live{0};
+std::atomic<std::size_t> peak{0};
+
+auto Allocate(std::size_t size, std::size_t alignment) -> void *
+{
+    size = std::max<std::size_t>(size, 1);
+    void *pointer = alignment > alignof(std::max_align_t)
+                        ? std::aligned_alloc(alignment, (size + alignment - 1) /
+                                                            alignment * alignment)
+                        : std::malloc(size);
+    if (pointer == nullptr)
+    {
+        throw std::bad_alloc{};
+    }
+    count.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    const std::size_t usable = malloc_usable_size(pointer);
+    const std::size_t now = live.fetch_add(usable, std::memory_order_relaxed) + usable;
+    std::size_t highest = peak.load(std::memory_order_relaxed);
+    while (now > highest && !peak.compare_exchange_weak(highest, now))
+    {
+    }
+    return pointer;
+}
+
+void Deallocate(void *pointer)
+{
+    if (pointer != nullptr)
+    {
+        live.fetch_sub(malloc_usable_size(pointer), std::memory_order_relaxed);
+        std::free(pointer);
+    }
+}
+
+auto OpenCounter(std::uint64_t config, int group) -> int
+{
+    perf_event_attr attributes{};
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.config = config;
+    attributes.disabled = group < 0 ? 1 : 0;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, group, 0));
+}
+
+auto ReadCounter(int descriptor) -> std::uint64_t
+{
+    std::uint64_t value = 0;
+    if (descriptor < 0 || read(descriptor, &value, sizeof(value)) != sizeof(value))
+    {
+        return 0;
+    }
+    return value;
+}
+
+} // namespace
+
+auto operator new(std::size_t size) -> void * { return Allocate(size, 0); }
+auto operator new[](std::size_t size) -> void * { return Allocate(size, 0); }
+auto operator new(std::size_t size, std::align_val_t alignment) -> void *
+{
+    return Allocate(size, static_cast<std::size_t>(alignment));
+}
+auto operator new[](std::size_t size, std::align_val_t alignment) -> void *
+{
+    return Allocate(size, static_cast<std::size_t>(alignment));
+}
+void operator delete(void *pointer) noexcept { Deallocate(pointer); }
+void operator delete[](void *pointer) noexcept { Deallocate(pointer); }
+void operator delete(void *pointer, std::size_t /*size*/) noexcept
+{
+    Deallocate(pointer);
+}
+void operator delete[](void *pointer, std::size_t /*size*/) noexcept
+{
+    Deallocate(pointer);
+}
+void operator delete(void *pointer, std::align_val_t /*alignment*/) noexcept
+{
+    Deallocate(pointer);
+}
+void operator delete[](void *pointer, std::align_val_t /*alignment*/) noexcept
+{
+    Deallocate(pointer);
+}
+void operator delete(void *pointer,
+                     std::size_t /*size*/,
+                     std::align_val_t /*alignment*/) noexcept
+{
+    Deallocate(pointer);
+}
+void operator delete[](void *pointer,
+                       std::size_t /*size*/,
+                       std::align_val_t /*alignment*/) noexcept
+{
+    Deallocate(pointer);
+}
+
+void ResetAllocations()
+{
+    count = 0;
+    bytes = 0;
+    peak = live.load();
+}
+
+auto ReadAllocations() -> Allocations { return {count, bytes, peak}; }
+
+void ResetPeakResident()
+{
+    // Writing 5 resets VmHWM, see proc(5).
+    std::ofstream{"/proc/self/clear_refs"} << "5";
+}
+
+auto PeakResident() -> std::size_t
+{
+    std::ifstream status{"/proc/self/status"};
+    for (std::string line; std::getline(status, line);)
+    {
+        if (line.starts_with("VmHWM:"))
+        {
+            return std::stoul(line.substr(6)) * 1024;
+        }
+    }
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+}
+
+HardwareCounters::HardwareCounters()
+{
+    leader = OpenCounter(PERF_COUNT_HW_CPU_CYCLES, -1);
+    if (leader < 0)
+    {
+        return;
+    }
+    cache_misses = OpenCounter(PERF_COUNT_HW_CACHE_MISSES, leader);
+    branch_misses = OpenCounter(PERF_COUNT_HW_BRANCH_MISSES, leader);
+}
+
+HardwareCounters::~HardwareCounters()
+{
+    for (const int descriptor : {branch_misses, cache_misses, leader})
+    {
+        if (descriptor >= 0)
+        {
+            close(descriptor);
+        }
+    }
+}
+
+void HardwareCounters::Start()
+{
+    if (Available())
+    {
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+auto HardwareCounters::Stop() -> std::optional<CounterValues>
+{
+    if (!Available())
+    {
+        return std::nullopt;
+    }
+    ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    return CounterValues{
+        ReadCounter(leader), ReadCounter(cache_misses), ReadCounter(branch_misses)};
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+// Heap activity counted by the replacement operator new and delete of the benchmark
+// executable since the last ResetAllocations().
+struct Allocations
+{
+    std::size_t count = 0;
+    std::size_t bytes = 0;
+    // Highest number of live heap bytes, counting those live when reset.
+    std::size_t peak = 0;
+};
+
+void ResetAllocations();
+auto ReadAllocations() -> Allocations;
+
+// Resets the peak resident set size of the process where the kernel supports it.
+void ResetPeakResident();
+
+// Peak resident set size in bytes since the last reset, or since the process started.
+auto PeakResident() -> std::size_t;
+
+struct CounterValues
+{
+    std::uint64_t cycles = 0;
+    std::uint64_t cache_misses = 0;
+    std::uint64_t branch_misses = 0;
+};
+
+// Hardware counters of the calling thread read through perf_event_open. Opening them
+// fails without kernel support or permission, in which case Available() is false and
+// nothing is counted.
+class HardwareCounters
+{
+  public:
+    HardwareCounters();
+    HardwareCounters(const HardwareCounters &) = delete;
+    HardwareCounters(HardwareCounters &&) = delete;
+    auto operator=(const HardwareCounters &) -> HardwareCounters & = delete;
+    auto operator=(HardwareCounters &&) -> HardwareCounters & = delete;
+    ~HardwareCounters();
+
+    [[nodiscard]] auto Available() const -> bool { return leader >= 0; }
+
+    void Start();
+    // Returns the counts since Start(), or nothing if the counters are unavailable.
+    auto Stop() -> std::optional<CounterValues>;
+
+  private:
+    int leader = -1;
+    int cache_misses = -1;
+    int branch_misses = -1;
+};
@@ -0,0 +1,155 @@
+#include "analysis.hpp"
+
+#include "box.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+namespace analysis
+{
+
+template <typename> inline constexpr bool AlwaysFalse = false;
+
+auto Anything() -> First
+{
+    First first;
+    first.set.Insert(std::numeric_limits<char>::min(), std::numeric_limits<char>::max());
+    return first;
+}
+
+FirstSets::FirstSets(const ast::Grammar &grammar)
+{
+    for (const auto &definition : grammar.definitions)
+    {
+        rules[definition.identifier.value] = First{};
+    }
+
+    // Start every rule from the empty set and grow until nothing changes.
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (const auto &definition : grammar.definitions)
+        {
+            const First first = Of(definition.expression);
+            First &current = rules[definition.identifier.value];
+            First grown{current.set, current.nullable || first.nullable};
+            grown.set |= first.set;
+            if (grown != current)
+            {
+                current = grown;
+                changed = true;
+            }
+        }
+    }
+}
+
+auto FirstSets::OfRule(const std::string &name) const -> First
+{
+    if (!rules.contains(name))
+    {
+        throw std::runtime_error("Tried to analyze rule " + name +
+                                 " but the grammar doesn't define it");
+    }
+    return rules.at(name);
+}
+
+auto FirstSets::Of(const ast::Expression &expression) const -> First
+{
+    return std::visit(
+        [this](auto &&expression)
+        {
+            using T = std::decay_t<decltype(expression)>;
+            if constexpr (std::is_same_v<T, Box<ast::Sequence>>)
+            {
+                First first{{}, true};
+                for (const auto &child : expression->children)
+                {
+                    const First next = Of(child);
+                    first.set |= next.set;
+                    if (!next.nullable)
+                    {
+                        first.nullable = false;
+                        break;
+                    }
+                }
+                return first;
+            }
+            else if constexpr (std::is_same_v<T, Box<ast::Optional>> ||
+                               std::is_same_v<T, Box<ast::ZeroOrMore>>)
+            {
+                return First{Of(expression->child).set, true};
+            }
+            else if constexpr (std::is_same_v<T, Box<ast::OneOrMore>> ||
+                               std::is_same_v<T, Box<ast::And>>)
+            {
+                return Of(expression->child);
+            }
+            else if constexpr (std::is_same_v<T, Box<ast::Not>>)
+            {
+                return First{{}, true};
+            }
+            else if constexpr (std::is_same_v<T, Box<ast::Alternative>>)
+            {
+                First first;
+                for (const auto &child : expression->children)
+                {
+                    const First next = Of(child);
+                    first.set |= next.set;
+                    first.nullable = first.nullable || next.nullable;
+                }
+                return first;
+            }
+            else if constexpr (std::is_same_v<T, ast::Class>)
+            {
+                First first;
+                for (const auto &literal : expression.literals)
+                {
+                    first.set |= Of(literal).set;
+                    first.nullable = first.nullable || literal.value.empty();
+                }
+                for (const auto &range : expression.ranges)
+                {
+                    first.set |= ToCharSet(range);
+                }
+                return first;
+            }
+            else if constexpr (std::is_same_v<T, ast::Dot>)
+            {
+                return Anything();
+            }
+            else if constexpr (std::is_same_v<T, ast::Literal>)
+            {
+                First first;
+                if (expression.value.empty())
+                {
+                    first.nullable = true;
+                }
+                else
+                {
+                    first.set.Insert(expression.value[0]);
+                }
+                return first;
+            }
+            else if constexpr (std::is_same_v<T, ast::Identifier>)
+            {
+                // Undefined rules are left for the backends to report.
+                if (!rules.contains(expression.value))
+                {
+                    return First{Anything().set, true};
+                }
+                return rules.at(expression.value);
+            }
+            else if constexpr (std::is_same_v<T, ast::Range>)
+            {
+                return First{ToCharSet(expression), false};
+            }
+            else
+            {
+                static_assert(AlwaysFalse<T>, "Did not visit all possible cases");
+            }
+        },
+        expression);
+}
+
+} // namespace analysis
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "ast.hpp"
+#include "charset.hpp"
+
+#include <map>
+#include <string>
+
+namespace analysis
+{
+
+// What an expression may begin with. If the expression succeeds at some offset then
+// either the byte there is in set, or the expression is nullable.
+struct First
+{
+    CharSet set;
+
+    // Whether the expression may succeed without consuming a byte from set, for
+    // example by matching the empty string or through a negative predicate.
+    bool nullable = false;
+
+    auto operator==(const First &) const -> bool = default;
+};
+
+// FIRST sets and nullability of every rule in a grammar, computed as a fixpoint so
+// recursive rules are handled.
+class FirstSets
+{
+  public:
+    explicit FirstSets(const ast::Grammar &grammar);
+
+    [[nodiscard]] auto Of(const ast::Expression &expression) const -> First;
+
+    [[nodiscard]] auto OfRule(const std::string &name) const -> First;
+
+  private:
+    std::map<std::string, First> rules;
+};
+
+} // namespace analysis
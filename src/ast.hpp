@@ -3,6 +3,7 @@
 #include "box.hpp"
 
 #include <concepts>
+#include <cstdint>
 #include <memory>
 #include <utility>
 #include <variant>
@@ -109,14 +110,26 @@ struct Sequence
     std::vector<Expression> children;
 };
 
+// How the match of a rule appears in the parse tree.
+enum class Shape : std::uint8_t
+{
+    Node,     // A NonTerminal named after the rule holding its children
+    Skip,     // Nothing, the match is dropped
+    Inline,   // The rule's children, spliced into the parent
+    Collapse, // The only child if there is exactly one, otherwise a Node
+    Token,    // A single Terminal spanning the whole match
+};
+
 struct Definition
 {
-    Definition(Identifier identifier, Expression expression)
-        : identifier{std::move(identifier)}, expression{std::move(expression)}
+    Definition(Identifier identifier, Expression expression, Shape shape = Shape::Node)
+        : identifier{std::move(identifier)}, expression{std::move(expression)},
+          shape{shape}
     {
     }
     Identifier identifier;
     Expression expression;
+    Shape shape;
 };
 
 struct Grammar
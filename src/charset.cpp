@@ -0,0 +1,146 @@
+#include "charset.hpp"
+
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void CharSet::Insert(char c)
+{
+    const auto byte = static_cast<unsigned char>(c);
+    bits[byte >> 6] |= std::uint64_t{1} << (byte & 63);
+    UpdateRanges();
+}
+
+void CharSet::Insert(char start, char end)
+{
+    for (int c = start; c <= end; c++)
+    {
+        const auto byte = static_cast<unsigned char>(c);
+        bits[byte >> 6] |= std::uint64_t{1} << (byte & 63);
+    }
+    UpdateRanges();
+}
+
+auto CharSet::operator|=(const CharSet &other) -> CharSet &
+{
+    for (std::size_t i = 0; i < bits.size(); i++)
+    {
+        bits[i] |= other.bits[i];
+    }
+    UpdateRanges();
+    return *this;
+}
+
+void CharSet::UpdateRanges()
+{
+    range_count = 0;
+    int byte = 0;
+    while (byte < 256)
+    {
+        if (!Contains(static_cast<char>(byte)))
+        {
+            byte++;
+            continue;
+        }
+        const int start = byte;
+        while (byte < 256 && Contains(static_cast<char>(byte)))
+        {
+            byte++;
+        }
+        if (range_count == MaxRanges)
+        {
+            range_count = 0;
+            return;
+        }
+        ranges[range_count++] = {static_cast<std::uint8_t>(start),
+                                 static_cast<std::uint8_t>(byte - 1)};
+    }
+}
+
+auto CharSet::Span(std::string_view source, std::size_t position) const -> std::size_t
+{
+    std::size_t end = position;
+#if defined(__SSE2__)
+    if (range_count > 0)
+    {
+        __m128i starts[MaxRanges];
+        __m128i widths[MaxRanges];
+        for (std::size_t i = 0; i < range_count; i++)
+        {
+            starts[i] = _mm_set1_epi8(static_cast<char>(ranges[i].first));
+            const auto width = static_cast<char>(ranges[i].second - ranges[i].first);
+            widths[i] = _mm_set1_epi8(width);
+        }
+        while (end + 16 <= source.size())
+        {
+            const __m128i block =
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(source.data() + end));
+            __m128i members = _mm_setzero_si128();
+            for (std::size_t i = 0; i < range_count; i++)
+            {
+                // A byte is in [start, start + width] when the wrapped difference
+                // does not exceed width, tested with an unsigned saturating subtract.
+                const __m128i offset = _mm_sub_epi8(block, starts[i]);
+                const __m128i excess = _mm_subs_epu8(offset, widths[i]);
+                members = _mm_or_si128(members,
+                                       _mm_cmpeq_epi8(excess, _mm_setzero_si128()));
+            }
+            const auto mask = static_cast<unsigned>(_mm_movemask_epi8(members));
+            if (mask != 0xFFFF)
+            {
+                return end + static_cast<std::size_t>(__builtin_ctz(~mask)) - position;
+            }
+            end += 16;
+        }
+    }
+#endif
+    while (end < source.size() && Contains(source[end]))
+    {
+        end++;
+    }
+    return end - position;
+}
+
+auto ToCharSet(const ast::Range &range) -> CharSet
+{
+    if (range.start.size() != 1 || range.end.size() != 1)
+    {
+        throw std::runtime_error("Expected range bounds to be length=1");
+    }
+    CharSet set;
+    set.Insert(range.start[0], range.end[0]);
+    return set;
+}
+
+auto ToCharSet(const ast::Class &cls) -> std::optional<CharSet>
+{
+    CharSet set;
+    for (const auto &literal : cls.literals)
+    {
+        if (literal.value.size() != 1)
+        {
+            return std::nullopt;
+        }
+        set.Insert(literal.value[0]);
+    }
+    for (const auto &range : cls.ranges)
+    {
+        set |= ToCharSet(range);
+    }
+    return set;
+}
+
+auto SingleByteSet(const ast::Expression &expression) -> std::optional<CharSet>
+{
+    if (std::holds_alternative<ast::Class>(expression))
+    {
+        return ToCharSet(std::get<ast::Class>(expression));
+    }
+    if (std::holds_alternative<ast::Range>(expression))
+    {
+        return ToCharSet(std::get<ast::Range>(expression));
+    }
+    return std::nullopt;
+}
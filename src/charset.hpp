@@ -0,0 +1,54 @@
+#pragma once
+
+#include "ast.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// A set of bytes stored as a 256-bit membership table.
+class CharSet
+{
+  public:
+    void Insert(char c);
+
+    // Inserts every byte between start and end, compared as chars like
+    // combinator::Range.
+    void Insert(char start, char end);
+
+    [[nodiscard]] auto Contains(char c) const -> bool
+    {
+        const auto byte = static_cast<unsigned char>(c);
+        return (bits[byte >> 6] >> (byte & 63) & 1) != 0;
+    }
+
+    auto operator|=(const CharSet &other) -> CharSet &;
+
+    auto operator==(const CharSet &other) const -> bool { return bits == other.bits; }
+
+    // Returns the length of the run of members starting at position. Sets made of a
+    // few byte ranges are scanned 16 bytes at a time when SSE2 is available.
+    [[nodiscard]] auto Span(std::string_view source, std::size_t position) const
+        -> std::size_t;
+
+  private:
+    void UpdateRanges();
+
+    static constexpr std::size_t MaxRanges = 4;
+
+    std::array<std::uint64_t, 4> bits{};
+
+    // The set as inclusive byte ranges, or empty if it needs more than MaxRanges.
+    std::array<std::pair<std::uint8_t, std::uint8_t>, MaxRanges> ranges{};
+    std::size_t range_count = 0;
+};
+
+// Returns the set matched by a class, or nothing if it has members longer than a byte.
+auto ToCharSet(const ast::Class &cls) -> std::optional<CharSet>;
+
+auto ToCharSet(const ast::Range &range) -> CharSet;
+
+// Returns the set matched by an expression that is a class or range of single bytes.
+auto SingleByteSet(const ast::Expression &expression) -> std::optional<CharSet>;
@@ -0,0 +1,432 @@
+#include "codegen.hpp"
+
+#include "box.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace codegen
+{
+
+template <typename> inline constexpr bool AlwaysFalse = false;
+
+namespace
+{
+
+// Literals shorter than this are matched with inline byte comparisons.
+constexpr std::size_t InlineLiteralLimit = 8;
+
+// Octal escapes always take three digits so that a digit after them is not read as
+// part of the escape.
+auto Escape(char c, char quote) -> std::string
+{
+    if (c == quote || c == '\\' || c < ' ' || c > '~')
+    {
+        std::ostringstream octal;
+        octal << "\\" << std::oct << std::setw(3) << std::setfill('0')
+              << static_cast<int>(static_cast<unsigned char>(c));
+        return octal.str();
+    }
+    return std::string(1, c);
+}
+
+auto CharLiteral(char c) -> std::string { return "'" + Escape(c, '\'') + "'"; }
+
+auto StringLiteral(const std::string &value) -> std::string
+{
+    std::string result = "\"";
+    for (const char c : value)
+    {
+        result += Escape(c, '"');
+    }
+    return result + "\"";
+}
+
+const char *const Prelude = R"(#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace NAME
+{
+
+struct Node
+{
+    // Rule name for non-terminals, empty for terminals.
+    std::string_view type;
+    // The span of input this node matched.
+    std::string_view value;
+    std::vector<Node> children;
+};
+
+struct Match
+{
+    std::vector<Node> nodes;
+    std::size_t position;
+};
+
+namespace detail
+{
+
+struct State
+{
+    std::string_view source;
+    std::size_t position;
+    std::vector<Node> nodes;
+};
+
+inline void Token(State &state, std::size_t size)
+{
+    state.nodes.push_back({{}, state.source.substr(state.position, size), {}});
+    state.position += size;
+}
+
+inline auto Reduce(State &state, std::string_view type, std::size_t start,
+                   std::size_t mark) -> bool
+{
+    Node node{type, state.source.substr(start, state.position - start), {}};
+    node.children.assign(std::make_move_iterator(state.nodes.begin() + mark),
+                         std::make_move_iterator(state.nodes.end()));
+    state.nodes.resize(mark);
+    state.nodes.push_back(std::move(node));
+    return true;
+}
+
+inline auto Capture(State &state, std::size_t start, std::size_t mark) -> bool
+{
+    state.nodes.resize(mark);
+    state.nodes.push_back({{}, state.source.substr(start, state.position - start), {}});
+    return true;
+}
+)";
+
+class Emitter
+{
+  public:
+    explicit Emitter(const ast::Grammar &grammar) : grammar{grammar}
+    {
+        for (const auto &definition : grammar.definitions)
+        {
+            if (!rules.insert(definition.identifier.value).second)
+            {
+                throw std::runtime_error("Tried to emit rule " +
+                                         definition.identifier.value +
+                                         " but it already exists");
+            }
+        }
+    }
+
+    auto EmitGrammar(const std::string &name) -> std::string
+    {
+        out << "// Generated by pegpp-gen. Do not edit.\n\n#pragma once\n\n";
+        std::string prelude = Prelude;
+        prelude.replace(prelude.find("NAME"), 4, name);
+        out << prelude << "\n";
+
+        for (const auto &definition : grammar.definitions)
+        {
+            out << "inline auto Rule" << definition.identifier.value
+                << "(State &state) -> bool;\n";
+        }
+        for (const auto &definition : grammar.definitions)
+        {
+            EmitDefinition(definition);
+        }
+        out << "\n} // namespace detail\n";
+
+        for (const auto &definition : grammar.definitions)
+        {
+            const auto &rule = definition.identifier.value;
+            out << "\ninline auto Parse" << rule
+                << "(std::string_view source) -> std::optional<Match>\n"
+                << "{\n"
+                << "    detail::State state{source, 0, {}};\n"
+                << "    if (!detail::Rule" << rule << "(state))\n"
+                << "    {\n"
+                << "        return std::nullopt;\n"
+                << "    }\n"
+                << "    return Match{std::move(state.nodes), state.position};\n"
+                << "}\n";
+        }
+        out << "\n} // namespace " << name << "\n";
+        return out.str();
+    }
+
+  private:
+    void Line(const std::string &text)
+    {
+        out << std::string(static_cast<std::size_t>(indent) * 4, ' ') << text << "\n";
+    }
+
+    void Open()
+    {
+        Line("{");
+        indent++;
+    }
+
+    void Close(const std::string &suffix = "")
+    {
+        indent--;
+        Line("}" + suffix);
+    }
+
+    auto Fresh(const std::string &prefix) -> std::string
+    {
+        return prefix + std::to_string(counter++);
+    }
+
+    void EmitDefinition(const ast::Definition &definition)
+    {
+        out << "\ninline auto Rule" << definition.identifier.value
+            << "(State &state) -> bool\n";
+        indent = 0;
+        Open();
+        Line("[[maybe_unused]] const std::size_t start = state.position;");
+        Line("[[maybe_unused]] const std::size_t mark = state.nodes.size();");
+        Line("bool ok = false;");
+        EmitExpression(definition.expression);
+        const std::string reduce = "Reduce(state, " +
+                                   StringLiteral(definition.identifier.value) +
+                                   ", start, mark)";
+        switch (definition.shape)
+        {
+        case ast::Shape::Node:
+            Line("return ok && " + reduce + ";");
+            break;
+        case ast::Shape::Skip:
+            Line("if (ok) state.nodes.resize(mark);");
+            Line("return ok;");
+            break;
+        case ast::Shape::Inline:
+            Line("return ok;");
+            break;
+        case ast::Shape::Collapse:
+            Line("return ok && (state.nodes.size() == mark + 1 || " + reduce + ");");
+            break;
+        case ast::Shape::Token:
+            Line("return ok && Capture(state, start, mark);");
+            break;
+        }
+        Close();
+    }
+
+    // Emits statements that set ok and, on failure, leave the state unchanged.
+    void EmitExpression(const ast::Expression &expression)
+    {
+        std::visit(
+            [this](auto &&expression)
+            {
+                using T = std::decay_t<decltype(expression)>;
+                if constexpr (std::is_same_v<T, Box<ast::Sequence>>)
+                {
+                    const auto position = Fresh("position");
+                    const auto mark = Fresh("mark");
+                    Open();
+                    Line("const std::size_t " + position + " = state.position;");
+                    Line("const std::size_t " + mark + " = state.nodes.size();");
+                    Line("ok = true;");
+                    Line("do");
+                    Open();
+                    for (const auto &child : expression->children)
+                    {
+                        EmitExpression(child);
+                        Line("if (!ok) break;");
+                    }
+                    Close(" while (false);");
+                    Line("if (!ok)");
+                    Open();
+                    Line("state.position = " + position + ";");
+                    Line("state.nodes.resize(" + mark + ");");
+                    Close();
+                    Close();
+                }
+                else if constexpr (std::is_same_v<T, Box<ast::Optional>>)
+                {
+                    EmitExpression(expression->child);
+                    Line("ok = true;");
+                }
+                else if constexpr (std::is_same_v<T, Box<ast::ZeroOrMore>>)
+                {
+                    Line("while (true)");
+                    Open();
+                    EmitExpression(expression->child);
+                    Line("if (!ok) break;");
+                    Close();
+                    Line("ok = true;");
+                }
+                else if constexpr (std::is_same_v<T, Box<ast::OneOrMore>>)
+                {
+                    const auto count = Fresh("count");
+                    Open();
+                    Line("std::size_t " + count + " = 0;");
+                    Line("while (true)");
+                    Open();
+                    EmitExpression(expression->child);
+                    Line("if (!ok) break;");
+                    Line(count + "++;");
+                    Close();
+                    Line("ok = " + count + " > 0;");
+                    Close();
+                }
+                else if constexpr (std::is_same_v<T, Box<ast::And>>)
+                {
+                    EmitPredicate(expression->child, false);
+                }
+                else if constexpr (std::is_same_v<T, Box<ast::Not>>)
+                {
+                    EmitPredicate(expression->child, true);
+                }
+                else if constexpr (std::is_same_v<T, Box<ast::Alternative>>)
+                {
+                    if (expression->children.empty())
+                    {
+                        throw std::runtime_error(
+                            "Expected alternative to contain at least one expression");
+                    }
+                    Line("do");
+                    Open();
+                    for (const auto &child : expression->children)
+                    {
+                        EmitExpression(child);
+                        Line("if (ok) break;");
+                    }
+                    Close(" while (false);");
+                }
+                else if constexpr (std::is_same_v<T, ast::Class>)
+                {
+                    EmitClass(expression);
+                }
+                else if constexpr (std::is_same_v<T, ast::Dot>)
+                {
+                    Line("ok = state.position < state.source.size();");
+                    Line("if (ok) Token(state, 1);");
+                }
+                else if constexpr (std::is_same_v<T, ast::Literal>)
+                {
+                    EmitLiteral(expression.value);
+                }
+                else if constexpr (std::is_same_v<T, ast::Identifier>)
+                {
+                    if (!rules.contains(expression.value))
+                    {
+                        throw std::runtime_error("Tried to call rule " +
+                                                 expression.value +
+                                                 " but the grammar doesn't define it");
+                    }
+                    Line("ok = Rule" + expression.value + "(state);");
+                }
+                else if constexpr (std::is_same_v<T, ast::Range>)
+                {
+                    EmitClass(ast::Class({expression}, {}));
+                }
+                else
+                {
+                    static_assert(AlwaysFalse<T>, "Did not visit all possible cases");
+                }
+            },
+            expression);
+    }
+
+    void EmitPredicate(const ast::Expression &child, bool negate)
+    {
+        const auto position = Fresh("position");
+        const auto mark = Fresh("mark");
+        Open();
+        Line("const std::size_t " + position + " = state.position;");
+        Line("const std::size_t " + mark + " = state.nodes.size();");
+        EmitExpression(child);
+        Line("state.position = " + position + ";");
+        Line("state.nodes.resize(" + mark + ");");
+        if (negate)
+        {
+            Line("ok = !ok;");
+        }
+        Close();
+    }
+
+    void EmitLiteral(const std::string &value)
+    {
+        if (value.size() > InlineLiteralLimit)
+        {
+            Line("ok = state.source.substr(state.position).starts_with(" +
+                 StringLiteral(value) + ");");
+        }
+        else
+        {
+            std::string condition = "state.source.size() - state.position >= " +
+                                    std::to_string(value.size());
+            for (std::size_t i = 0; i < value.size(); i++)
+            {
+                condition += " && state.source[state.position + " + std::to_string(i) +
+                             "] == " + CharLiteral(value[i]);
+            }
+            Line("ok = " + condition + ";");
+        }
+        Line("if (ok) Token(state, " + std::to_string(value.size()) + ");");
+    }
+
+    void EmitClass(const ast::Class &cls)
+    {
+        const auto single = [](const ast::Literal &literal)
+        { return literal.value.size() == 1; };
+        if (!std::all_of(cls.literals.begin(), cls.literals.end(), single))
+        {
+            // Multi-byte members keep the ordered choice of literals then ranges.
+            ast::Alternative alternative;
+            for (const auto &literal : cls.literals)
+            {
+                alternative.children.emplace_back(literal);
+            }
+            for (const auto &range : cls.ranges)
+            {
+                alternative.children.emplace_back(range);
+            }
+            EmitExpression(Box(std::move(alternative)));
+            return;
+        }
+
+        std::string condition;
+        for (const auto &literal : cls.literals)
+        {
+            condition += (condition.empty() ? "" : " || ") + std::string("c == ") +
+                         CharLiteral(literal.value[0]);
+        }
+        for (const auto &range : cls.ranges)
+        {
+            if (range.start.size() != 1 || range.end.size() != 1)
+            {
+                throw std::runtime_error("Expected range bounds to be length=1");
+            }
+            condition += (condition.empty() ? "" : " || ") + std::string("(c >= ") +
+                         CharLiteral(range.start[0]) + " && c <= " +
+                         CharLiteral(range.end[0]) + ")";
+        }
+        Line("ok = state.position < state.source.size();");
+        Line("if (ok)");
+        Open();
+        Line("const char c = state.source[state.position];");
+        Line("ok = " + (condition.empty() ? std::string("false") : condition) + ";");
+        Line("if (ok) Token(state, 1);");
+        Close();
+    }
+
+    const ast::Grammar &grammar;
+    std::set<std::string> rules;
+    std::ostringstream out;
+    int indent = 0;
+    int counter = 0;
+};
+
+} // namespace
+
+auto Emit(const ast::Grammar &grammar, const std::string &name) -> std::string
+{
+    Emitter emitter{grammar};
+    return emitter.EmitGrammar(name);
+}
+
+} // namespace codegen
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "ast.hpp"
+
+#include <string>
+
+// Ahead-of-time backend that translates an ast::Grammar into a standalone C++ header
+// with one function per rule. The generated code only depends on the standard library
+// and produces the same tree shapes as Generate().
+namespace codegen
+{
+
+auto Emit(const ast::Grammar &grammar, const std::string &name) -> std::string;
+
+} // namespace codegen
@@ -1,26 +1,376 @@
-
 #include "combinator.hpp"
 
+#include <algorithm>
+#include <array>
 #include <stdexcept>
+#include <utility>
 
 namespace combinator
 {
 
+namespace
+{
+
+// Returns where the places from begin on in the stream start in placed. They are
+// those of the matches that started at or after begin, since backtracking and
+// reducing never cut into a match that has ended.
+template <typename Items>
+auto Placed(Placement<Items> &placement, std::size_t begin)
+    -> std::vector<std::size_t>::iterator
+{
+    auto &placed = placement.placed;
+    auto first = placed.end();
+    while (first != placed.begin() && placement.places[*std::prev(first)].begin >= begin)
+    {
+        --first;
+    }
+    return first;
+}
+
+// Places the items a successful memoized call appended to its stream between begin
+// and end, if any.
+template <typename Items>
+auto Record(Placement<Items> &placement, std::size_t begin, std::size_t end)
+    -> std::size_t
+{
+    if (begin == end)
+    {
+        return Memo::none;
+    }
+    const std::size_t index = placement.places.size();
+    placement.places.push_back(Place{Place::Owner::Stream, 0, begin, end});
+    placement.placed.push_back(index);
+    return index;
+}
+
+// Moves the items of stream from mark on aside, before the caller drops them, if
+// memoized matches refer to them.
+template <typename Items>
+void Hold(Placement<Items> &placement,
+          Items &stream,
+          std::size_t mark,
+          const typename Items::allocator_type &allocator)
+{
+    const auto placed = Placed(placement, mark);
+    if (placed == placement.placed.end())
+    {
+        return;
+    }
+    const std::size_t index = placement.held.size();
+    const auto first = stream.begin() + static_cast<std::ptrdiff_t>(mark);
+    auto &held = placement.held.emplace_back(typename Placement<Items>::Held{
+        Items{std::make_move_iterator(first),
+              std::make_move_iterator(stream.end()),
+              allocator},
+        {placed, placement.placed.end()}});
+    for (const std::size_t moved : held.places)
+    {
+        Place &place = placement.places[moved];
+        place = Place{Place::Owner::Held, index, place.begin - mark, place.end - mark};
+    }
+    placement.placed.erase(placed, placement.placed.end());
+}
+
+// Moves the held items of place back to the end of stream, with the places among
+// them. Returns false, leaving them held, if a place covers part of them only, as
+// it would be cut.
+template <typename Items>
+auto Restore(Placement<Items> &placement, Items &stream, const Place &place) -> bool
+{
+    auto &held = placement.held[place.index];
+    const bool whole = std::ranges::all_of(
+        held.places,
+        [&](std::size_t other)
+        {
+            const Place &inner = placement.places[other];
+            return inner.end <= place.begin || inner.begin >= place.end ||
+                   (inner.begin >= place.begin && inner.end <= place.end);
+        });
+    if (!whole)
+    {
+        return false;
+    }
+    const auto first = held.items.begin() + static_cast<std::ptrdiff_t>(place.begin);
+    const auto last = held.items.begin() + static_cast<std::ptrdiff_t>(place.end);
+    const std::size_t base = stream.size();
+    stream.insert(
+        stream.end(), std::make_move_iterator(first), std::make_move_iterator(last));
+    held.items.erase(first, last);
+
+    // Places after the items move down, those of the items move with them.
+    const std::size_t size = place.end - place.begin;
+    std::vector<std::size_t> kept;
+    for (const std::size_t other : held.places)
+    {
+        Place &inner = placement.places[other];
+        if (inner.begin >= place.end)
+        {
+            inner.begin -= size;
+            inner.end -= size;
+            kept.push_back(other);
+        }
+        else if (inner.begin < place.begin)
+        {
+            kept.push_back(other);
+        }
+        else
+        {
+            inner = Place{Place::Owner::Stream,
+                          0,
+                          inner.begin - place.begin + base,
+                          inner.end - place.begin + base};
+            placement.placed.push_back(other);
+        }
+    }
+    held.places = std::move(kept);
+    return true;
+}
+
+// Delivers the buffered events once no enclosing parser can backtrack over them.
+void Commit(Context &context)
+{
+    if (context.visitor == nullptr || context.backtrack != 0)
+    {
+        return;
+    }
+    for (const Event &event : context.events)
+    {
+        switch (event.kind)
+        {
+        case Event::Kind::Enter:
+            context.visitor->OnEnter(event.rule, event.start);
+            break;
+        case Event::Kind::Exit:
+            context.visitor->OnExit(event.rule, event.start, event.end);
+            break;
+        case Event::Kind::Token:
+            context.visitor->OnToken(
+                context.source.substr(event.start, event.end - event.start));
+            break;
+        }
+    }
+    context.event_places.Lose();
+    context.events.clear();
+}
+
+void Emit(Context &context, const Event &event)
+{
+    context.events.push_back(event);
+    Commit(context);
+}
+
+// Drops the events buffered since mark. Events emitted outside of any backtracking
+// parser are delivered at once, so the buffer may already be shorter than mark; the
+// failure then propagates to the top and fails the whole parse.
+void Discard(Context &context, std::size_t mark)
+{
+    if (mark < context.events.size())
+    {
+        Hold(context.event_places, context.events, mark, {});
+        context.events.resize(mark);
+    }
+}
+
+// Runs parser where its failure does not fail the enclosing parser, so its events are
+// held back until it is known whether they are kept.
+auto Attempt(const Parser &parser, Context &context, std::size_t position) -> Result
+{
+    context.backtrack++;
+    Result result = parser(context, position);
+    context.backtrack--;
+    if (std::holds_alternative<Success>(result))
+    {
+        Commit(context);
+    }
+    return result;
+}
+
+// Appends a terminal spanning size bytes at position to the output.
+auto Token(Context &context, std::size_t position, std::size_t size) -> Result
+{
+    if (context.build)
+    {
+        context.output.push_back(Terminal{context.source.substr(position, size)});
+    }
+    if (context.visitor != nullptr)
+    {
+        Emit(context, Event{Event::Kind::Token, {}, position, position + size});
+    }
+    return Result{Success{{}, position + size}};
+}
+
+// Runs parser without building nodes, running actions or emitting events, as
+// predicates only need to know if it matches.
+auto Recognize(const Parser &parser, Context &context, std::size_t position) -> Result
+{
+    const bool build = std::exchange(context.build, false);
+    const bool evaluate = std::exchange(context.evaluate, false);
+    Visitor *visitor = std::exchange(context.visitor, nullptr);
+    Result result = parser(context, position);
+    context.build = build;
+    context.evaluate = evaluate;
+    context.visitor = visitor;
+    return result;
+}
+
+// Whether parsers must report the structure of what they match.
+auto Structured(const Context &context) -> bool
+{
+    return context.build || context.visitor != nullptr;
+}
+
+// Drops the nodes appended to the output since mark.
+void Truncate(Context &context, std::size_t mark)
+{
+    Hold(context.node_places, context.output, mark, context.resource);
+    context.output.erase(context.output.begin() + static_cast<std::ptrdiff_t>(mark),
+                         context.output.end());
+}
+
+// Replaces the nodes appended since mark with one NonTerminal holding them.
+void Reduce(Context &context, std::size_t mark, const std::string &type)
+{
+    auto &output = context.output;
+    const auto first = output.begin() + static_cast<std::ptrdiff_t>(mark);
+    Nodes children{std::make_move_iterator(first),
+                   std::make_move_iterator(output.end()),
+                   context.resource};
+    output.erase(first, output.end());
+    std::pmr::string name{type, context.resource};
+    output.push_back(NonTerminal{std::move(name), std::move(children)});
+
+    // Places among the children now index the new node, which gets a place of its own.
+    auto &placement = context.node_places;
+    const auto placed = Placed(placement, mark);
+    if (placed != placement.placed.end())
+    {
+        const std::size_t index = placement.places.size();
+        for (auto it = placed; it != placement.placed.end(); ++it)
+        {
+            Place &place = placement.places[*it];
+            place = Place{
+                Place::Owner::Node, index, place.begin - mark, place.end - mark};
+        }
+        placement.placed.erase(placed, placement.placed.end());
+        Record(placement, mark, mark + 1);
+    }
+}
+
+// Returns the nodes that the begin and end of place index into, or nothing if they
+// are lost.
+auto Locate(Context &context, const Place &place) -> const Nodes *
+{
+    switch (place.owner)
+    {
+    case Place::Owner::Stream:
+        return &context.output;
+    case Place::Owner::Held:
+        return &context.node_places.held[place.index].items;
+    case Place::Owner::Node:
+    {
+        const Place &parent = context.node_places.places[place.index];
+        const Nodes *nodes = Locate(context, parent);
+        if (nodes == nullptr)
+        {
+            return nullptr;
+        }
+        return &std::get<NonTerminal>((*nodes)[parent.begin]).children;
+    }
+    case Place::Owner::Lost:
+        break;
+    }
+    return nullptr;
+}
+
+// Appends the nodes of place index to the output again, moving them back if they are
+// held and copying them otherwise. Returns false if they are lost.
+auto ReplayNodes(Context &context, std::size_t index) -> bool
+{
+    const Place place = context.node_places.places[index];
+    if (place.owner == Place::Owner::Held &&
+        Restore(context.node_places, context.output, place))
+    {
+        return true;
+    }
+    const Nodes *nodes = Locate(context, place);
+    if (nodes == nullptr)
+    {
+        return false;
+    }
+    // Copied aside first, as appending may move the nodes copied from.
+    Nodes copy{context.resource};
+    copy.reserve(place.end - place.begin);
+    for (std::size_t i = place.begin; i < place.end; i++)
+    {
+        copy.push_back(Clone((*nodes)[i], context.resource));
+    }
+    context.output.insert(context.output.end(),
+                          std::make_move_iterator(copy.begin()),
+                          std::make_move_iterator(copy.end()));
+    return true;
+}
+
+// Buffers the events of place index again like ReplayNodes(). Returns false if they
+// were delivered.
+auto ReplayEvents(Context &context, std::size_t index) -> bool
+{
+    auto &placement = context.event_places;
+    const Place place = placement.places[index];
+    if (place.owner == Place::Owner::Lost)
+    {
+        return false;
+    }
+    if (place.owner == Place::Owner::Held && Restore(placement, context.events, place))
+    {
+        return true;
+    }
+    const auto &events = place.owner == Place::Owner::Held
+                             ? placement.held[place.index].items
+                             : context.events;
+    const auto first = events.begin() + static_cast<std::ptrdiff_t>(place.begin);
+    const auto last = events.begin() + static_cast<std::ptrdiff_t>(place.end);
+    // Copied aside first, as appending may move the events copied from.
+    const std::vector<Event> copy{first, last};
+    context.events.insert(context.events.end(), copy.begin(), copy.end());
+    return true;
+}
+
+// Counts the top-level nodes among the events buffered since mark.
+auto Children(const Context &context, std::size_t mark) -> std::size_t
+{
+    std::size_t count = 0;
+    std::size_t depth = 0;
+    for (std::size_t i = mark; i < context.events.size(); i++)
+    {
+        switch (context.events[i].kind)
+        {
+        case Event::Kind::Enter:
+            count += depth == 0 ? 1 : 0;
+            depth++;
+            break;
+        case Event::Kind::Exit:
+            depth--;
+            break;
+        case Event::Kind::Token:
+            count += depth == 0 ? 1 : 0;
+            break;
+        }
+    }
+    return count;
+}
+
+} // namespace
+
 auto Literal(const std::string &value) -> Parser
 {
-    return [value](const std::string &input)
+    return [value](Context &context, std::size_t position)
     {
-        for (unsigned int i = 0; i < value.size(); i++)
+        const std::string_view input = context.source.substr(position);
+        if (!input.starts_with(value))
         {
-            if (value[i] != input[i])
-            {
-                return Result{Failure{"Literal"}};
-            }
+            return Result{Failure{"Literal"}};
         }
-        Terminal terminal{std::string(value)};
-        std::string remainder{input.begin() + static_cast<int>(value.size()),
-                              input.end()};
-        return Result{Success{{terminal}, remainder}};
+        return Token(context, position, value.size());
     };
 }
 
@@ -30,63 +380,177 @@ auto Range(const std::string &start, const std::string &end) -> Parser
     {
         throw std::runtime_error("Expected range bounds to be length=1");
     }
-    return [start, end](const std::string &input)
+    return [start, end](Context &context, std::size_t position)
     {
-        char c = input[0];
+        if (position >= context.source.size())
+        {
+            return Result{Failure{"Range"}};
+        }
+        char c = context.source[position];
         if (c >= start[0] && c <= end[0])
         {
-            Terminal terminal{{input.begin(), input.begin() + 1}};
-            std::string remainder{input.begin() + 1, input.end()};
-            return Result{Success{{terminal}, remainder}};
+            return Token(context, position, 1);
         }
         return Result{Failure{"Range"}};
     };
 }
 
+auto Keywords(const std::vector<std::string> &values) -> Parser
+{
+    if (values.empty())
+    {
+        throw std::runtime_error("Expected keywords to contain at least one literal");
+    }
+    std::vector<std::size_t> sizes;
+    sizes.reserve(values.size());
+    for (const auto &value : values)
+    {
+        sizes.push_back(value.size());
+    }
+    return [trie = Trie{values}, sizes](Context &context, std::size_t position)
+    {
+        const std::string_view input = context.source.substr(position);
+        const auto match = trie.Match(input);
+        if (!match)
+        {
+            return Result{Failure{"Keywords"}};
+        }
+        return Token(context, position, sizes[*match]);
+    };
+}
+
+auto Class(const CharSet &set) -> Parser
+{
+    return [set](Context &context, std::size_t position)
+    {
+        if (position >= context.source.size() || !set.Contains(context.source[position]))
+        {
+            return Result{Failure{"Class"}};
+        }
+        return Token(context, position, 1);
+    };
+}
+
+auto Run(const CharSet &set, std::size_t minimum) -> Parser
+{
+    return [set, minimum](Context &context, std::size_t position)
+    {
+        const std::size_t length = set.Span(context.source, position);
+        if (length < minimum)
+        {
+            return Result{Failure{"Run"}};
+        }
+        for (std::size_t i = 0; Structured(context) && i < length; i++)
+        {
+            Token(context, position + i, 1);
+        }
+        return Result{Success{{}, position + length}};
+    };
+}
+
 auto Sequence(const std::vector<Parser> &parsers) -> Parser
 {
     if (parsers.empty())
     {
         throw std::runtime_error("Expected sequence to contain at least one parser");
     }
-    return [parsers](const std::string &input)
+    return [parsers](Context &context, std::size_t position)
     {
-        std::vector<Node> nodes;
-        std::string source = input;
+        const std::size_t mark = context.output.size();
+        const std::size_t values = context.values.size();
+        const std::size_t events = context.events.size();
         for (const auto &parser : parsers)
         {
-            const Result result = parser(source);
+            const Result result = parser(context, position);
             if (std::holds_alternative<Failure>(result))
             {
+                Truncate(context, mark);
+                context.values.resize(values);
+                Discard(context, events);
                 return Result{Failure{"Sequence"}};
             }
+            position = std::get<Success>(result).position;
+        }
+        return Result{Success{{}, position}};
+    };
+}
 
-            const auto &success = std::get<Success>(result);
-            for (const auto &node : success.node)
+auto Alternative(const std::vector<Parser> &parsers) -> Parser
+{
+    if (parsers.empty())
+    {
+        throw std::runtime_error("Expected alternative to contain at least one parser");
+    }
+    return [parsers](Context &context, std::size_t position)
+    {
+        for (std::size_t i = 0; i + 1 < parsers.size(); i++)
+        {
+            Result result = Attempt(parsers[i], context, position);
+            if (std::holds_alternative<Success>(result))
             {
-                nodes.push_back(node);
+                return result;
             }
-            source = success.remainder;
         }
-        return Result{Success{nodes, source}};
+        // The last alternative fails the choice, so it needs no backtracking.
+        Result result = parsers.back()(context, position);
+        if (std::holds_alternative<Success>(result))
+        {
+            return result;
+        }
+        return Result{Failure{"Alternative"}};
     };
 }
 
-auto Alternative(const std::vector<Parser> &parsers) -> Parser
+auto Alternative(const std::vector<Parser> &parsers,
+                 const std::vector<analysis::First> &firsts) -> Parser
 {
     if (parsers.empty())
     {
         throw std::runtime_error("Expected alternative to contain at least one parser");
     }
-    return [parsers](const std::string &input)
+    if (parsers.size() != firsts.size())
     {
-        for (const auto &parser : parsers)
+        throw std::runtime_error("Expected one FIRST set per alternative");
+    }
+
+    // Map every byte, and the end of input at index 256, to the list of parsers
+    // that may succeed there. Identical lists are shared.
+    std::vector<std::vector<std::size_t>> candidates;
+    std::array<std::size_t, 257> table{};
+    for (std::size_t byte = 0; byte < table.size(); byte++)
+    {
+        std::vector<std::size_t> list;
+        for (std::size_t i = 0; i < firsts.size(); i++)
+        {
+            if (firsts[i].nullable ||
+                (byte < 256 && firsts[i].set.Contains(static_cast<char>(byte))))
+            {
+                list.push_back(i);
+            }
+        }
+        const auto found = std::find(candidates.begin(), candidates.end(), list);
+        table[byte] = static_cast<std::size_t>(found - candidates.begin());
+        if (found == candidates.end())
+        {
+            candidates.push_back(std::move(list));
+        }
+    }
+
+    return [parsers, candidates, table](Context &context, std::size_t position)
+    {
+        const std::size_t byte =
+            position < context.source.size()
+                ? static_cast<unsigned char>(context.source[position])
+                : 256;
+        const auto &list = candidates[table[byte]];
+        for (std::size_t i = 0; i < list.size(); i++)
         {
-            const Result result = parser(input);
+            const Parser &parser = parsers[list[i]];
+            Result result = i + 1 < list.size() ? Attempt(parser, context, position)
+                                                : parser(context, position);
             if (std::holds_alternative<Success>(result))
             {
-                const auto &success = std::get<Success>(result);
-                return Result{success};
+                return result;
             }
         }
         return Result{Failure{"Alternative"}};
@@ -95,85 +559,64 @@ auto Alternative(const std::vector<Parser> &parsers) -> Parser
 
 auto Optional(const Parser &parser) -> Parser
 {
-    return [parser](const std::string &input)
+    return [parser](Context &context, std::size_t position)
     {
-        const Result result = parser(input);
+        Result result = Attempt(parser, context, position);
         if (std::holds_alternative<Success>(result))
         {
-            const auto &success = std::get<Success>(result);
-            return Result{success};
+            return result;
         }
-        Success success{{}, input};
-        return Result{success};
+        return Result{Success{{}, position}};
     };
 }
 
 auto OneOrMore(const Parser &parser) -> Parser
 {
-    return [parser](const std::string &input)
+    return [parser](Context &context, std::size_t position)
     {
-        const Result result = parser(input);
+        const Result result = parser(context, position);
         if (std::holds_alternative<Failure>(result))
         {
             return Result{Failure{"Sequence"}};
         }
-
-        const auto &success = std::get<Success>(result);
-
-        std::vector<Node> nodes{success.node};
-        std::string source = success.remainder;
+        position = std::get<Success>(result).position;
 
         while (true)
         {
-            const Result result = parser(source);
+            const Result result = Attempt(parser, context, position);
             if (std::holds_alternative<Failure>(result))
             {
-                return Result{Success{nodes, source}};
-            }
-
-            const auto &success = std::get<Success>(result);
-            for (const auto &node : success.node)
-            {
-                nodes.push_back(node);
+                return Result{Success{{}, position}};
             }
-            source = success.remainder;
+            position = std::get<Success>(result).position;
         }
     };
 }
 
 auto ZeroOrMore(const Parser &parser) -> Parser
 {
-    return [parser](const std::string &input)
+    return [parser](Context &context, std::size_t position)
     {
-        std::vector<Node> nodes;
-        std::string source = input;
-
         while (true)
         {
-            const Result result = parser(source);
+            const Result result = Attempt(parser, context, position);
             if (std::holds_alternative<Failure>(result))
             {
-                return Result{Success{nodes, source}};
-            }
-
-            const auto &success = std::get<Success>(result);
-            for (const auto &node : success.node)
-            {
-                nodes.push_back(node);
+                return Result{Success{{}, position}};
             }
-            source = success.remainder;
+            position = std::get<Success>(result).position;
         }
     };
 }
 
 auto And(const Parser &parser) -> Parser
 {
-    return [parser](const std::string &input)
+    return [parser](Context &context, std::size_t position)
     {
-        Result result = parser(input);
+        Result result = Recognize(parser, context, position);
         if (std::holds_alternative<Success>(result))
         {
-            return Result{Success{{}, input}};
+            return Result{Success{{}, position}};
         }
         return result;
     };
@@ -181,42 +624,266 @@ auto And(const Parser &parser) -> Parser
 
 auto Not(const Parser &parser) -> Parser
 {
-    return [parser](const std::string &input)
+    return [parser](Context &context, std::size_t position)
     {
-        Result result = parser(input);
+        const Result result = Recognize(parser, context, position);
         if (std::holds_alternative<Success>(result))
         {
             return Result{Failure{"Not"}};
         }
-        return Result{Success{{}, input}};
+        return Result{Success{{}, position}};
     };
 }
 
 auto Dot() -> Parser
 {
-    return [](const std::string &input)
+    return [](Context &context, std::size_t position)
     {
-        if (input.empty())
+        if (position >= context.source.size())
         {
             return Result{Failure{{"Dot"}}};
         }
-        std::string rest{input.begin() + 1, input.end()};
-        Terminal terminal{std::string(input.begin(), input.begin() + 1)};
-        return Result{Success{{terminal}, rest}};
+        return Token(context, position, 1);
     };
 }
 
 auto Definition(const Parser &parser, const std::string &type) -> Parser
 {
-    return [parser, type](const std::string &input)
+    return [parser, type](Context &context, std::size_t position)
     {
-        Result result = parser(input);
+        if (!Structured(context))
+        {
+            return parser(context, position);
+        }
+        const std::size_t mark = context.output.size();
+        const std::size_t events = context.events.size();
+        if (context.visitor != nullptr)
+        {
+            Emit(context, Event{Event::Kind::Enter, type, position, position});
+        }
+        Result result = parser(context, position);
+        if (const auto *success = std::get_if<Success>(&result))
+        {
+            if (context.build)
+            {
+                Reduce(context, mark, type);
+            }
+            if (context.visitor != nullptr)
+            {
+                const std::size_t end = success->position;
+                Emit(context, Event{Event::Kind::Exit, type, position, end});
+            }
+        }
+        else
+        {
+            Discard(context, events);
+        }
+        return result;
+    };
+}
+
+auto Skip(const Parser &parser) -> Parser
+{
+    return [parser](Context &context, std::size_t position)
+    { return Recognize(parser, context, position); };
+}
+
+auto Collapse(const Parser &parser, const std::string &type) -> Parser
+{
+    return [parser, type](Context &context, std::size_t position)
+    {
+        if (!Structured(context))
+        {
+            return parser(context, position);
+        }
+        const std::size_t mark = context.output.size();
+        const std::size_t events = context.events.size();
+        // Held back until it is known whether the rule's own events are needed.
+        context.backtrack++;
+        Result result = parser(context, position);
+        context.backtrack--;
+        const auto *success = std::get_if<Success>(&result);
+        if (success != nullptr && context.build && context.output.size() != mark + 1)
+        {
+            Reduce(context, mark, type);
+        }
+        if (success != nullptr && context.visitor != nullptr &&
+            Children(context, events) != 1)
+        {
+            const Event enter{Event::Kind::Enter, type, position, position};
+            context.events.insert(
+                context.events.begin() + static_cast<std::ptrdiff_t>(events), enter);
+            auto &placement = context.event_places;
+            for (auto it = Placed(placement, events); it != placement.placed.end(); ++it)
+            {
+                placement.places[*it].begin++;
+                placement.places[*it].end++;
+            }
+            context.events.push_back(
+                Event{Event::Kind::Exit, type, position, success->position});
+        }
+        Commit(context);
+        return result;
+    };
+}
+
+auto Capture(const Parser &parser) -> Parser
+{
+    return [parser](Context &context, std::size_t position)
+    {
+        if (!Structured(context))
+        {
+            return parser(context, position);
+        }
+        Result result = Recognize(parser, context, position);
+        if (const auto *success = std::get_if<Success>(&result))
+        {
+            Token(context, position, success->position - position);
+        }
+        return result;
+    };
+}
+
+auto Apply(const Parser &parser, const Action &action) -> Parser
+{
+    return [parser, action](Context &context, std::size_t position)
+    {
+        if (!context.evaluate)
+        {
+            return parser(context, position);
+        }
+        const std::size_t mark = context.values.size();
+        Result result = parser(context, position);
+        if (const auto *success = std::get_if<Success>(&result))
+        {
+            auto &values = context.values;
+            const std::string_view text =
+                context.source.substr(position, success->position - position);
+            std::any value = action(text, std::span<std::any>{values}.subspan(mark));
+            values.resize(mark);
+            values.push_back(std::move(value));
+        }
+        return result;
+    };
+}
+
+auto Instrument(const Parser &parser, std::size_t rule, const std::string &name) -> Parser
+{
+    return [parser, rule, name](Context &context, std::size_t position)
+    {
+        Profile *profile = context.profile;
+        Tracer *tracer = context.tracer;
+        if (profile == nullptr && tracer == nullptr)
+        {
+            return parser(context, position);
+        }
+        if (profile != nullptr)
+        {
+            profile->Enter(rule, name, position);
+        }
+        if (tracer != nullptr)
+        {
+            tracer->Enter();
+        }
+        Result result = parser(context, position);
+        std::optional<std::size_t> end;
+        if (const auto *success = std::get_if<Success>(&result))
+        {
+            end = success->position;
+        }
+        if (tracer != nullptr)
+        {
+            tracer->Exit(name, position, end);
+        }
+        if (profile != nullptr)
+        {
+            profile->Exit(end);
+        }
+        return result;
+    };
+}
+
+auto Memoize(const Parser &parser, std::size_t slot) -> Parser
+{
+    return [parser, slot](Context &context, std::size_t position)
+    {
+        if (context.memo.size() <= slot)
+        {
+            context.memo.resize(slot + 1);
+            context.recognized.resize(slot + 1);
+        }
+        if (const auto it = context.memo[slot].find(position);
+            it != context.memo[slot].end())
+        {
+            const Memo &memo = it->second;
+            const auto *success = std::get_if<Success>(&memo.result);
+            if (success == nullptr)
+            {
+                return memo.result;
+            }
+            if (context.evaluate)
+            {
+                context.values.insert(
+                    context.values.end(), memo.values.begin(), memo.values.end());
+            }
+            // Only one of the streams is ever wanted.
+            const bool replayed =
+                (!context.build || memo.nodes == Memo::none ||
+                 ReplayNodes(context, memo.nodes)) &&
+                (context.visitor == nullptr || memo.events == Memo::none ||
+                 ReplayEvents(context, memo.events));
+            if (replayed)
+            {
+                Commit(context);
+                return Result{Success{{}, success->position}};
+            }
+            // Its nodes or events went away with an earlier stream.
+            context.memo[slot].erase(it);
+        }
+
+        if (!Structured(context) && !context.evaluate)
+        {
+            if (const auto it = context.recognized[slot].find(position);
+                it != context.recognized[slot].end())
+            {
+                return Result{Success{{}, it->second}};
+            }
+            // Nested memoized parsers may grow the tables, so they are indexed again.
+            Result result = parser(context, position);
+            if (const auto *success = std::get_if<Success>(&result))
+            {
+                context.recognized[slot].emplace(position, success->position);
+            }
+            else
+            {
+                // Failures do not depend on whether nodes are built.
+                context.memo[slot].emplace(position, Memo{result});
+            }
+            return result;
+        }
+
+        const std::size_t nodes = context.output.size();
+        const std::size_t values = context.values.size();
+        const std::size_t events = context.events.size();
+        // Events are delivered as soon as they are emitted when nothing can backtrack
+        // over them, and then cannot be replayed.
+        const bool buffered = context.visitor == nullptr || context.backtrack > 0;
+        Result result = parser(context, position);
+        Memo memo{result};
         if (std::holds_alternative<Success>(result))
         {
-            const auto &success = std::get<Success>(result);
-            NonTerminal node{type, success.node};
-            return Result{Success{{node}, success.remainder}};
+            if (!buffered)
+            {
+                return result;
+            }
+            memo.nodes = Record(context.node_places, nodes, context.output.size());
+            // Actions may move from the values they are given, so they are copied.
+            memo.values.assign(
+                context.values.begin() + static_cast<std::ptrdiff_t>(values),
+                context.values.end());
+            memo.events = Record(context.event_places, events, context.events.size());
         }
+        context.memo[slot].emplace(position, std::move(memo));
         return result;
     };
 }
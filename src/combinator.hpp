@@ -1,6 +1,9 @@
 #pragma once
 
+#include "analysis.hpp"
+#include "charset.hpp"
 #include "parser.hpp"
+#include "trie.hpp"
 
 namespace combinator
 {
@@ -9,10 +12,26 @@ auto Literal(const std::string &value) -> Parser;
 
 auto Range(const std::string &start, const std::string &end) -> Parser;
 
+// Ordered choice between literals, matched with a trie so the cost does not grow with
+// the number of literals. The nodes are the same as for an Alternative of Literals.
+auto Keywords(const std::vector<std::string> &values) -> Parser;
+
+// Matches a single byte from set.
+auto Class(const CharSet &set) -> Parser;
+
+// Matches a run of at least minimum bytes from set, scanning the run in bulk. The
+// nodes are the same as for repeating Class(set).
+auto Run(const CharSet &set, std::size_t minimum) -> Parser;
+
 auto Sequence(const std::vector<Parser> &parsers) -> Parser;
 
 auto Alternative(const std::vector<Parser> &parsers) -> Parser;
 
+// An ordered choice that only tries the parsers whose FIRST set admits the next byte,
+// given one First per parser. Earlier parsers are still tried first.
+auto Alternative(const std::vector<Parser> &parsers,
+                 const std::vector<analysis::First> &firsts) -> Parser;
+
 auto Optional(const Parser &parser) -> Parser;
 
 auto OneOrMore(const Parser &parser) -> Parser;
@@ -27,4 +46,26 @@ auto Dot() -> Parser;
 
 auto Definition(const Parser &parser, const std::string &type) -> Parser;
 
+// Matches like parser but adds no nodes.
+auto Skip(const Parser &parser) -> Parser;
+
+// Like Definition, but a match that produced exactly one node is left as that node.
+auto Collapse(const Parser &parser, const std::string &type) -> Parser;
+
+// Matches like parser but adds a single terminal spanning the whole match.
+auto Capture(const Parser &parser) -> Parser;
+
+// Replaces the values produced while parser matched with the value action computes
+// from them. Only has an effect while evaluating.
+auto Apply(const Parser &parser, const Action &action) -> Parser;
+
+// Reports every call of parser, the rule numbered rule, to the Profile and Tracer of the
+// context. Costs two pointer tests per call while the context has neither.
+auto Instrument(const Parser &parser, std::size_t rule, const std::string &name)
+    -> Parser;
+
+// Caches the result of parser per input offset in the parse context. Each memoized
+// parser must be given a distinct slot.
+auto Memoize(const Parser &parser, std::size_t slot) -> Parser;
+
 }; // namespace combinator
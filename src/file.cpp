@@ -0,0 +1,97 @@
+#include "file.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+auto Error(const std::string &path, const std::string &reason) -> std::runtime_error
+{
+    return std::runtime_error("Tried to map file " + path + " but " + reason + ": " +
+                              std::strerror(errno));
+}
+
+} // namespace
+
+MappedFile::MappedFile(const std::string &path)
+{
+    const int descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0)
+    {
+        throw Error(path, "it could not be opened");
+    }
+
+    struct stat status
+    {
+    };
+    if (fstat(descriptor, &status) != 0)
+    {
+        const auto error = Error(path, "its size is unknown");
+        close(descriptor);
+        throw error;
+    }
+    if (static_cast<std::uintmax_t>(status.st_size) >
+        std::numeric_limits<std::size_t>::max())
+    {
+        close(descriptor);
+        throw std::runtime_error("Tried to map file " + path +
+                                 " but it is larger than the address space");
+    }
+
+    // Mapping nothing is an error, so empty files keep an empty view.
+    const auto length = static_cast<std::size_t>(status.st_size);
+    if (length > 0)
+    {
+        void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (mapping == MAP_FAILED)
+        {
+            const auto error = Error(path, "it could not be mapped");
+            close(descriptor);
+            throw error;
+        }
+        // Parsers mostly move forward, so the kernel may read ahead aggressively.
+        madvise(mapping, length, MADV_SEQUENTIAL);
+        data = static_cast<const char *>(mapping);
+        size = length;
+    }
+    // The mapping stays valid once the descriptor is closed.
+    close(descriptor);
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : data{std::exchange(other.data, nullptr)}, size{std::exchange(other.size, 0)}
+{
+}
+
+auto MappedFile::operator=(MappedFile &&other) noexcept -> MappedFile &
+{
+    if (this != &other)
+    {
+        Unmap();
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() { Unmap(); }
+
+void MappedFile::Unmap()
+{
+    if (data != nullptr)
+    {
+        munmap(const_cast<char *>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// A read-only view of a whole file mapped into memory. Pages are read on demand as the
+// parser reaches them, so files of any size can be parsed in place without first
+// reading them into a string. Offsets into the view are std::size_t, so inputs larger
+// than 4 GB are supported on 64-bit platforms.
+class MappedFile
+{
+  public:
+    // Throws if the file cannot be opened or mapped.
+    explicit MappedFile(const std::string &path);
+    MappedFile(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    auto operator=(const MappedFile &) -> MappedFile & = delete;
+    auto operator=(MappedFile &&other) noexcept -> MappedFile &;
+    ~MappedFile();
+
+    // The contents of the file, valid for the lifetime of the mapping.
+    [[nodiscard]] auto View() const -> std::string_view { return {data, size}; }
+
+  private:
+    void Unmap();
+
+    const char *data = nullptr;
+    std::size_t size = 0;
+};
@@ -0,0 +1,42 @@
+#include "codegen.hpp"
+#include "file.hpp"
+#include "reader.hpp"
+
+#include <fstream>
+#include <iostream>
+
+// Reads a PEG grammar file and writes a standalone C++ header that parses it.
+auto main(int argc, char **argv) -> int
+{
+    if (argc < 3 || argc > 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " <grammar.peg> <namespace> [output.hpp]"
+                  << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        const MappedFile source{argv[1]};
+        const auto grammar = ReadGrammar(source.View());
+        const auto code = codegen::Emit(grammar, argv[2]);
+        if (argc == 3)
+        {
+            std::cout << code;
+            return 0;
+        }
+        std::ofstream output{argv[3]};
+        output << code;
+        if (!output)
+        {
+            std::cerr << "Failed to write " << argv[3] << std::endl;
+            return 1;
+        }
+    }
+    catch (const std::exception &error)
+    {
+        std::cerr << argv[1] << ": " << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -3,12 +3,36 @@
 
 #include "box.hpp"
 
+#include <algorithm>
+
 template <typename> inline constexpr bool AlwaysFalse = false;
 
-auto EmitExpression(const ast::Expression &expression, Collection &collection) -> Parser
+// Returns the values of an ordered choice made only of literals.
+auto Literals(const std::vector<ast::Expression> &alternatives)
+    -> std::optional<std::vector<std::string>>
+{
+    if (alternatives.empty())
+    {
+        return std::nullopt;
+    }
+    std::vector<std::string> values;
+    for (const auto &alternative : alternatives)
+    {
+        if (!std::holds_alternative<ast::Literal>(alternative))
+        {
+            return std::nullopt;
+        }
+        values.push_back(std::get<ast::Literal>(alternative).value);
+    }
+    return values;
+}
+
+auto EmitExpression(const ast::Expression &expression,
+                    Collection &collection,
+                    const analysis::FirstSets &firsts) -> Parser
 {
     return std::visit(
-        [&collection](auto &&expression)
+        [&collection, &firsts](auto &&expression)
         {
             using T = std::decay_t<decltype(expression)>;
             if constexpr (std::is_same_v<T, Box<ast::Sequence>>)
@@ -17,58 +41,93 @@ auto EmitExpression(const ast::Expression &expression, Collection &collection) -
                 parsers.reserve(expression->children.size());
                 for (const ast::Expression &child : expression->children)
                 {
-                    parsers.push_back(EmitExpression(child, collection));
+                    parsers.push_back(EmitExpression(child, collection, firsts));
                 }
                 return combinator::Sequence(parsers);
             }
             else if constexpr (std::is_same_v<T, Box<ast::Optional>>)
             {
                 return combinator::Optional(
-                    EmitExpression(expression->child, collection));
+                    EmitExpression(expression->child, collection, firsts));
             }
             else if constexpr (std::is_same_v<T, Box<ast::ZeroOrMore>>)
             {
+                if (const auto set = SingleByteSet(expression->child))
+                {
+                    return combinator::Run(*set, 0);
+                }
                 return combinator::ZeroOrMore(
-                    EmitExpression(expression->child, collection));
+                    EmitExpression(expression->child, collection, firsts));
             }
             else if constexpr (std::is_same_v<T, Box<ast::OneOrMore>>)
             {
+                if (const auto set = SingleByteSet(expression->child))
+                {
+                    return combinator::Run(*set, 1);
+                }
                 return combinator::OneOrMore(
-                    EmitExpression(expression->child, collection));
+                    EmitExpression(expression->child, collection, firsts));
             }
             else if constexpr (std::is_same_v<T, Box<ast::And>>)
             {
-                return combinator::And(EmitExpression(expression->child, collection));
+                return combinator::And(
+                    EmitExpression(expression->child, collection, firsts));
             }
             else if constexpr (std::is_same_v<T, Box<ast::Not>>)
             {
-                return combinator::Not(EmitExpression(expression->child, collection));
+                return combinator::Not(
+                    EmitExpression(expression->child, collection, firsts));
             }
             else if constexpr (std::is_same_v<T, Box<ast::Alternative>>)
             {
+                if (const auto literals = Literals(expression->children))
+                {
+                    return combinator::Keywords(*literals);
+                }
+
                 std::vector<Parser> parsers;
+                std::vector<analysis::First> branches;
                 parsers.reserve(expression->children.size());
                 for (const ast::Expression &child : expression->children)
                 {
-                    parsers.push_back(EmitExpression(child, collection));
+                    parsers.push_back(EmitExpression(child, collection, firsts));
+                    branches.push_back(firsts.Of(child));
+                }
+                // Dispatch on the next byte unless every branch may match anything.
+                const auto prunable = [](const analysis::First &branch)
+                { return !branch.nullable; };
+                if (std::any_of(branches.begin(), branches.end(), prunable))
+                {
+                    return combinator::Alternative(parsers, branches);
                 }
                 return combinator::Alternative(parsers);
             }
             else if constexpr (std::is_same_v<T, ast::Class>)
             {
                 const ast::Class &cls = expression;
+                if (const auto set = ToCharSet(cls))
+                {
+                    return combinator::Class(*set);
+                }
 
-                std::vector<Parser> parsers;
-                parsers.reserve(cls.literals.size() + cls.ranges.size());
+                // Multi-byte members keep the ordered choice of literals then ranges.
+                std::vector<std::string> members;
                 for (const auto &literal : cls.literals)
                 {
-                    parsers.push_back(EmitExpression(literal, collection));
+                    members.push_back(literal.value);
                 }
                 for (const auto &range : cls.ranges)
                 {
-                    parsers.push_back(EmitExpression(range, collection));
+                    if (range.start.size() != 1 || range.end.size() != 1)
+                    {
+                        throw std::runtime_error("Expected range bounds to be length=1");
+                    }
+                    for (int c = range.start[0]; c <= range.end[0]; c++)
+                    {
+                        members.emplace_back(1, static_cast<char>(c));
+                    }
                 }
-                return combinator::Alternative(parsers);
+                return combinator::Keywords(members);
             }
             else if constexpr (std::is_same_v<T, ast::Dot>)
             {
@@ -80,11 +139,16 @@ auto EmitExpression(const ast::Expression &expression, Collection &collection) -
             }
             else if constexpr (std::is_same_v<T, ast::Identifier>)
             {
-                Parser parser = [&](const std::string &input)
+                if (!collection.Contains(expression.value))
                 {
-                    auto res = collection.Get(expression.value)(input);
-                    return res;
-                };
+                    throw std::runtime_error("Tried to call rule " + expression.value +
+                                             " but the grammar doesn't define it");
+                }
+                // Rules are declared before any expression is emitted, so the slot
+                // exists even if the rule is defined further down.
+                const Parser *rule = collection.Slot(expression.value);
+                Parser parser = [rule](Context &context, std::size_t position)
+                { return (*rule)(context, position); };
                 return parser;
             }
             else if constexpr (std::is_same_v<T, ast::Range>)
@@ -99,14 +163,78 @@ auto EmitExpression(const ast::Expression &expression, Collection &collection) -
         expression);
 }
 
-auto Generate(const ast::Grammar &grammar) -> Collection
+// Wraps the parser for a rule's expression so its match takes the rule's shape.
+auto EmitDefinition(const Parser &expression, const ast::Definition &definition)
+    -> Parser
 {
+    const auto &name = definition.identifier.value;
+    switch (definition.shape)
+    {
+    case ast::Shape::Node:
+        return combinator::Definition(expression, name);
+    case ast::Shape::Skip:
+        return combinator::Skip(expression);
+    case ast::Shape::Inline:
+        return expression;
+    case ast::Shape::Collapse:
+        return combinator::Collapse(expression, name);
+    case ast::Shape::Token:
+        return combinator::Capture(expression);
+    }
+    throw std::runtime_error("Tried to generate rule " + name + " with an unknown shape");
+}
+
+auto Generate(const ast::Grammar &grammar, const Options &options) -> Collection
+{
+    const auto require = [&grammar](const std::string &name, const std::string &what)
+    {
+        const auto defined = [&name](const ast::Definition &definition)
+        { return definition.identifier.value == name; };
+        if (std::none_of(grammar.definitions.begin(), grammar.definitions.end(), defined))
+        {
+            throw std::runtime_error("Tried to " + what + " rule " + name +
+                                     " but the grammar doesn't define it");
+        }
+    };
+    for (const auto &name : options.memoize)
+    {
+        require(name, "memoize");
+    }
+    for (const auto &[name, action] : options.actions)
+    {
+        require(name, "attach an action to");
+    }
+
     Collection collection;
+    std::vector<std::size_t> rule_slots;
+    rule_slots.reserve(grammar.definitions.size());
     for (const auto &definition : grammar.definitions)
     {
-        const auto expr = EmitExpression(definition.expression, collection);
-        const auto def = combinator::Definition(expr, definition.identifier.value);
-        collection.Add(definition.identifier.value, def);
+        rule_slots.push_back(collection.Declare(definition.identifier.value));
+    }
+
+    const analysis::FirstSets firsts{grammar};
+
+    std::size_t memo_slots = 0;
+    for (std::size_t i = 0; i < grammar.definitions.size(); i++)
+    {
+        const auto &definition = grammar.definitions[i];
+        const auto expr = EmitExpression(definition.expression, collection, firsts);
+        auto def = EmitDefinition(expr, definition);
+        if (const auto it = options.actions.find(definition.identifier.value);
+            it != options.actions.end())
+        {
+            def = combinator::Apply(def, it->second);
+        }
+        if (options.instrument)
+        {
+            def = combinator::Instrument(def, i, definition.identifier.value);
+        }
+        if (options.packrat || options.memoize.contains(definition.identifier.value))
+        {
+            def = combinator::Memoize(def, memo_slots++);
+        }
+        collection.Define(rule_slots[i], def);
     }
     return collection;
 }
@@ -3,38 +3,205 @@
 #include "ast.hpp"
 #include "parser.hpp"
 
+#include <memory>
+#include <set>
+
+// Rules are stored in an indexed table of slots. Slots are allocated on the heap so
+// that parsers can hold direct pointers to the rules they call, which stay valid when
+// the collection is moved.
+//
+// A collection is move-only. Once built, its parsers hold no mutable state, so const
+// member functions may be called from any number of threads at once. Each thread
+// passes its own Context to reuse memo tables between parses.
 struct Collection
 {
 
   public:
-    void Add(const std::string &name, const Parser &parser)
+    Collection() = default;
+    Collection(const Collection &) = delete;
+    Collection(Collection &&) noexcept = default;
+    auto operator=(const Collection &) -> Collection & = delete;
+    auto operator=(Collection &&) noexcept -> Collection & = default;
+    ~Collection() = default;
+
+    // Reserves a slot for name so that references to it can be linked before the
+    // rule itself is added.
+    auto Declare(const std::string &name) -> std::size_t
     {
-        if (storage.contains(name))
+        if (index.contains(name))
         {
             throw std::runtime_error("Tried to add parser " + name +
                                      " to collection but it already exists");
         }
-        storage[name] = parser;
+        index[name] = slots.size();
+        slots.push_back(std::make_unique<Parser>());
+        return slots.size() - 1;
     }
 
-    [[nodiscard]] auto Get(const std::string &name) const -> Parser
+    void Define(std::size_t slot, const Parser &parser) { *slots.at(slot) = parser; }
+
+    void Add(const std::string &name, const Parser &parser)
     {
-        if (storage.contains(name))
+        Define(Declare(name), parser);
+    }
+
+    [[nodiscard]] auto Contains(const std::string &name) const -> bool
+    {
+        return index.contains(name);
+    }
+
+    // Returns the slot holding name. The pointer is stable for the lifetime of the
+    // collection.
+    [[nodiscard]] auto Slot(const std::string &name) const -> const Parser *
+    {
+        if (const auto it = index.find(name); it != index.end())
         {
-            return storage.at(name);
+            return slots[it->second].get();
         }
         throw std::runtime_error("Tried to retrieve parser " + name +
-                                 " from collection but it doens't exist");
+                                 " from collection but it doesn't exist");
+    }
+
+    [[nodiscard]] auto Get(const std::string &name) const -> Parser
+    {
+        return *Slot(name);
     }
 
-    [[nodiscard]] auto Parse(const std::string &name, const std::string &source) const
+    [[nodiscard]] auto Parse(const std::string &name, std::string_view source) const
         -> Result
     {
-        return Get(name)(source);
+        return ::Parse(*Slot(name), source);
+    }
+
+    [[nodiscard]] auto Parse(const std::string &name,
+                             std::string_view source,
+                             Context &context) const -> Result
+    {
+        return ::Parse(*Slot(name), source, context);
+    }
+
+    [[nodiscard]] auto Parse(const std::string &name,
+                             std::string_view source,
+                             Context &context,
+                             Arena &arena) const -> const Result &
+    {
+        return ::Parse(*Slot(name), source, context, arena);
+    }
+
+    // Parses every input with rule name on up to jobs threads, one per hardware thread
+    // when jobs is zero. Results are returned in the order of the inputs.
+    [[nodiscard]] auto ParseBatch(const std::string &name,
+                                  std::span<const std::string_view> inputs,
+                                  std::size_t jobs = 0) const -> std::vector<Result>
+    {
+        return ::ParseBatch(*Slot(name), inputs, jobs);
+    }
+
+    // Parses source as consecutive matches of rule unit on up to jobs threads, split
+    // where matches of rule sync end. The nodes are those of a sequential parse.
+    [[nodiscard]] auto ParseParallel(const std::string &unit,
+                                     const std::string &sync,
+                                     std::string_view source,
+                                     std::size_t jobs = 0) const -> Success
+    {
+        return ::ParseParallel(*Slot(unit), *Slot(sync), source, jobs);
+    }
+
+    // Validates source against rule name without building a tree. Returns the end of
+    // the match, or nothing if the rule does not match.
+    [[nodiscard]] auto Match(const std::string &name, std::string_view source) const
+        -> std::optional<std::size_t>
+    {
+        return ::Match(*Slot(name), source);
+    }
+
+    [[nodiscard]] auto Match(const std::string &name,
+                             std::string_view source,
+                             Context &context) const -> std::optional<std::size_t>
+    {
+        return ::Match(*Slot(name), source, context);
+    }
+
+    // Streams the matches of rule name to visitor instead of building a tree. Returns
+    // the end of the match, or nothing if the rule does not match.
+    [[nodiscard]] auto Visit(const std::string &name,
+                             std::string_view source,
+                             Visitor &visitor) const -> std::optional<std::size_t>
+    {
+        Context context{source};
+        return ::Visit(*Slot(name), source, visitor, context);
+    }
+
+    [[nodiscard]] auto Visit(const std::string &name,
+                             std::string_view source,
+                             Visitor &visitor,
+                             Context &context) const -> std::optional<std::size_t>
+    {
+        return ::Visit(*Slot(name), source, visitor, context);
+    }
+
+    // Iterates over the consecutive matches of rule name, parsing one record at a
+    // time. The collection, source and context must outlive the range.
+    [[nodiscard]] auto Records(const std::string &name,
+                               std::string_view source,
+                               Context &context) const -> ::Records
+    {
+        return ::Records{*Slot(name), source, context};
+    }
+
+    // Runs the semantic actions attached to the rules while matching rule name and
+    // returns the value it produced, or nothing if the rule does not match.
+    [[nodiscard]] auto Evaluate(const std::string &name, std::string_view source) const
+        -> std::optional<std::any>
+    {
+        Context context{source};
+        return ::Evaluate(*Slot(name), source, context);
+    }
+
+    [[nodiscard]] auto Evaluate(const std::string &name,
+                                std::string_view source,
+                                Context &context) const -> std::optional<std::any>
+    {
+        return ::Evaluate(*Slot(name), source, context);
+    }
+
+    // Like Evaluate() but casts the value to T, throwing std::bad_any_cast if the
+    // rule produced a value of another type.
+    template <typename T>
+    [[nodiscard]] auto Evaluate(const std::string &name, std::string_view source) const
+        -> std::optional<T>
+    {
+        auto value = Evaluate(name, source);
+        if (!value)
+        {
+            return std::nullopt;
+        }
+        return std::any_cast<T>(std::move(*value));
     }
 
   private:
-    std::map<std::string, Parser> storage;
+    std::vector<std::unique_ptr<Parser>> slots;
+    std::map<std::string, std::size_t> index;
+};
+
+struct Options
+{
+    // Memoize the result of every rule per input offset (packrat parsing), which
+    // guarantees linear time at the cost of memory.
+    bool packrat = false;
+
+    // Rules to memoize when packrat is disabled. Memoizing small lexical rules such
+    // as Spacing usually costs more than re-parsing them.
+    std::set<std::string> memoize;
+
+    // Semantic actions by rule name. They only run when a rule is evaluated, where
+    // each computes its rule's value from the values of the rules it matched.
+    std::map<std::string, Action> actions;
+
+    // Wrap every rule so that a Profile or Tracer set on the Context records its calls.
+    // Without it rules carry no instrumentation at all. Reused memoized results are
+    // not counted as calls.
+    bool instrument = false;
 };
 
-auto Generate(const ast::Grammar &grammar) -> Collection;
+auto Generate(const ast::Grammar &grammar, const Options &options = {}) -> Collection;
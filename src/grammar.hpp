@@ -2,7 +2,7 @@
 
 #include "ast.hpp"
 
-auto GetPegGrammarAST() -> ast::Grammar
+inline auto GetPegGrammarAST() -> ast::Grammar
 {
     using namespace ast;
     return {
@@ -61,7 +61,7 @@ auto GetPegGrammarAST() -> ast::Grammar
                                                      Identifier("Char"))),
                                  Class({}, {Literal("'")}),
                                  Identifier("Spacing")),
-                        Sequence(Class({}, {Literal("'")}),
+                        Sequence(Class({}, {Literal("\"")}),
                                  ZeroOrMore(Sequence(Not(Class({}, {Literal("\"")})),
                                                      Identifier("Char"))),
                                  Class({}, {Literal("\"")}),
@@ -1,73 +1,189 @@
-#include "ast.hpp"
-#include "combinator.hpp"
+#include "file.hpp"
 #include "generator.hpp"
-#include "grammar.hpp"
 #include "parser.hpp"
+#include "pool.hpp"
+#include "reader.hpp"
 
 #include <iostream>
-#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
 
-auto CreatePegParser(const std::string &grammar) -> void
+namespace
 {
-    const auto peg_grammar = GetPegGrammarAST();
-    const auto peg = Generate(peg_grammar);
-    const auto parse = peg.Parse("Grammar", grammar);
-    if (std::holds_alternative<Success>(parse))
-    {
-        std::cout << "Parser success!" << std::endl;
-        const auto &success = std::get<Success>(parse);
-        for (const auto &node : success.node)
-        {
-            Dump(node);
-        }
-    }
-    else
-    {
-        std::cout << "Parser failure!" << std::endl;
-    }
-}
 
-auto main() -> int
+void Usage(const char *program)
 {
-    using namespace ast;
+    std::cerr << "Usage: " << program
+              << " [--tree] [--jobs N] <grammar.peg> <rule> <input>..." << std::endl;
+}
 
-    const std::string grammar = "Expression <- Number BinaryOperand Number\n"
-                                "BinaryOperand <- Plus / Minus\n"
-                                "Plus <- '+'\n"
-                                "Minus <- '-'\n"
-                                "Number <- [0-9]\n";
-    CreatePegParser(grammar);
+// What parsing one input file found.
+struct Outcome
+{
+    std::optional<std::size_t> end;
+    std::size_t size = 0;
+    std::string error;
+};
 
-    auto grammar_ast =
-        Grammar(Definition(Identifier("Expression"),
-                           Box(Sequence(Identifier("Number"),
-                                        Identifier("BinaryOperand"),
-                                        Identifier("Number")))),
-                Definition(Identifier("BinaryOperand"),
-                           Box(Alternative(Identifier("Plus"), Identifier("Minus")))),
-                Definition(Identifier("Plus"), Literal("+")),
-                Definition(Identifier("Minus"), Literal("-")),
-                Definition(Identifier("Number"), Range("0", "9")));
+auto Validate(const Collection &collection,
+              const std::string &rule,
+              const std::vector<std::string> &paths,
+              std::size_t jobs) -> std::vector<Outcome>
+{
+    std::vector<Outcome> outcomes(paths.size());
+    std::vector<Context> contexts(Workers(jobs, paths.size()));
+    ParallelFor(paths.size(),
+                jobs,
+                [&](std::size_t worker, std::size_t index)
+                {
+                    // Each file is only mapped while it is parsed.
+                    try
+                    {
+                        const MappedFile input{paths[index]};
+                        outcomes[index].size = input.View().size();
+                        outcomes[index].end =
+                            collection.Match(rule, input.View(), contexts[worker]);
+                    }
+                    catch (const std::exception &error)
+                    {
+                        outcomes[index].error = error.what();
+                    }
+                });
+    return outcomes;
+}
 
-    std::cout << "Created grammar" << std::endl;
-    const auto collection = Generate(grammar_ast);
+auto Print(const Collection &collection,
+           const std::string &rule,
+           const std::vector<std::string> &paths,
+           std::size_t jobs) -> std::vector<Outcome>
+{
+    std::vector<Outcome> outcomes(paths.size());
+    std::vector<Context> contexts(Workers(jobs, paths.size()));
+    std::mutex output;
+    ParallelFor(paths.size(),
+                jobs,
+                [&](std::size_t worker, std::size_t index)
+                {
+                    // Like Validate, but each tree is printed as soon as it is built and
+                    // dropped with its file.
+                    try
+                    {
+                        const MappedFile input{paths[index]};
+                        outcomes[index].size = input.View().size();
+                        const auto result =
+                            collection.Parse(rule, input.View(), contexts[worker]);
+                        const auto *success = std::get_if<Success>(&result);
+                        if (success == nullptr)
+                        {
+                            return;
+                        }
+                        outcomes[index].end = success->position;
+                        const std::lock_guard lock{output};
+                        if (paths.size() > 1)
+                        {
+                            std::cout << paths[index] << ":" << std::endl;
+                        }
+                        for (const auto &node : success->node)
+                        {
+                            Dump(node);
+                        }
+                    }
+                    catch (const std::exception &error)
+                    {
+                        outcomes[index].error = error.what();
+                    }
+                });
+    return outcomes;
+}
 
-    std::cout << "Created collection" << std::endl;
+} // namespace
 
-    const auto result = collection.Get("Expression")("1+2");
-    if (std::holds_alternative<Success>(result))
+// Parses input files with rule of a PEG grammar file. Every file is memory-mapped and
+// parsed in place, on up to N threads with --jobs N. Prints how much of each input the
+// rule matched, and with --tree the parse trees. Exits with 0 only if the rule matched
+// every input whole.
+auto main(int argc, char **argv) -> int
+{
+    bool tree = false;
+    std::size_t jobs = 1;
+    std::vector<std::string> arguments;
+    for (int i = 1; i < argc; i++)
     {
-        std::cout << "Parser success!" << std::endl;
-        const auto &success = std::get<Success>(result);
-        for (const auto &node : success.node)
+        const std::string argument = argv[i];
+        if (argument == "--tree")
         {
-            Dump(node);
+            tree = true;
+        }
+        else if (argument == "--jobs" && i + 1 < argc)
+        {
+            try
+            {
+                jobs = std::stoul(argv[++i]);
+            }
+            catch (const std::exception &)
+            {
+                std::cerr << "Expected a number of jobs but got " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (argument.starts_with("--"))
+        {
+            std::cerr << "Unknown option " << argument << std::endl;
+            Usage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            arguments.push_back(argument);
         }
     }
-    else
+    if (arguments.size() < 3)
     {
-        std::cout << "Parser failure!" << std::endl;
+        Usage(argv[0]);
+        return 1;
     }
+    const std::string &rule = arguments[1];
+    const std::vector<std::string> paths(arguments.begin() + 2, arguments.end());
 
-    return 0;
+    try
+    {
+        const MappedFile grammar{arguments[0]};
+        const auto collection = Generate(ReadGrammar(grammar.View()));
+        const auto outcomes = tree ? Print(collection, rule, paths, jobs)
+                                   : Validate(collection, rule, paths, jobs);
+
+        int status = 0;
+        for (std::size_t i = 0; i < paths.size(); i++)
+        {
+            const Outcome &outcome = outcomes[i];
+            if (!outcome.error.empty())
+            {
+                std::cerr << outcome.error << std::endl;
+                status = 1;
+                continue;
+            }
+            if (!outcome.end)
+            {
+                std::cerr << paths[i] << ": rule " << rule << " does not match"
+                          << std::endl;
+                status = 1;
+                continue;
+            }
+            if (paths.size() > 1)
+            {
+                std::cout << paths[i] << ": ";
+            }
+            std::cout << "Matched " << *outcome.end << " of " << outcome.size << " bytes"
+                      << std::endl;
+            status = *outcome.end == outcome.size ? status : 1;
+        }
+        return status;
+    }
+    catch (const std::exception &error)
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
 }
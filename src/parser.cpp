@@ -1,5 +1,9 @@
 #include "parser.hpp"
 
+#include "pool.hpp"
+
+#include <algorithm>
+
 static void Indent(int level)
 {
     for (int i = 0; i < level; ++i)
@@ -33,3 +37,372 @@ void Dump(const Node &node, int level)
         },
         node);
 }
+
+namespace
+{
+
+// Runs parser over the context from position and collects its output into the result.
+auto Run(const Parser &parser, Context &context, std::size_t position = 0) -> Result
+{
+    Result result = parser(context, position);
+    if (const auto *success = std::get_if<Success>(&result))
+    {
+        // Built in place: assigning would keep the allocator of the empty node list.
+        result.emplace<Success>(Nodes{std::make_move_iterator(context.output.begin()),
+                                      std::make_move_iterator(context.output.end()),
+                                      context.resource},
+                                success->position);
+    }
+    context.output.clear();
+    // Memoized matches cannot replay nodes that are no longer in the context.
+    context.node_places.Lose();
+    return result;
+}
+
+// Restores the mode of a context on leaving a scope, including when an action or a
+// visitor throws, so that the context can be reused.
+class Mode
+{
+  public:
+    explicit Mode(Context &context)
+        : context{context},
+          build{context.build},
+          evaluate{context.evaluate},
+          visitor{context.visitor},
+          resource{context.resource}
+    {
+    }
+    Mode(const Mode &) = delete;
+    Mode(Mode &&) = delete;
+    auto operator=(const Mode &) -> Mode & = delete;
+    auto operator=(Mode &&) -> Mode & = delete;
+
+    ~Mode()
+    {
+        context.build = build;
+        context.evaluate = evaluate;
+        context.visitor = visitor;
+        context.resource = resource;
+    }
+
+  private:
+    Context &context;
+    bool build;
+    bool evaluate;
+    Visitor *visitor;
+    std::pmr::memory_resource *resource;
+};
+
+// Consecutive units parsed from some offset.
+struct Units
+{
+    Nodes nodes;
+    std::size_t end;
+    // Whether a unit failed or matched nothing, which ends the sequence.
+    bool stopped = false;
+};
+
+// Parses units from position until they reach limit or stop.
+auto ParseUnits(const Parser &unit,
+                std::string_view source,
+                std::size_t position,
+                std::size_t limit,
+                Context &context) -> Units
+{
+    Units units{{}, position};
+    context.Reset(source);
+    while (units.end < limit)
+    {
+        Result result = Run(unit, context, units.end);
+        auto *success = std::get_if<Success>(&result);
+        if (success == nullptr || success->position == units.end)
+        {
+            units.stopped = true;
+            break;
+        }
+        units.nodes.insert(units.nodes.end(),
+                           std::make_move_iterator(success->node.begin()),
+                           std::make_move_iterator(success->node.end()));
+        units.end = success->position;
+    }
+    return units;
+}
+
+// Returns where the first match of sync at or after position ends, or the end of the
+// input if there is none.
+auto Synchronize(const Parser &sync,
+                 std::string_view source,
+                 std::size_t position,
+                 Context &context) -> std::size_t
+{
+    context.Reset(source);
+    const Mode mode{context};
+    context.build = false;
+    std::size_t end = source.size();
+    for (; position < source.size(); position++)
+    {
+        const Result result = sync(context, position);
+        if (const auto *success = std::get_if<Success>(&result))
+        {
+            end = success->position;
+            break;
+        }
+    }
+    return end;
+}
+
+} // namespace
+
+auto Parse(const Parser &parser, std::string_view source) -> Result
+{
+    Context context{source};
+    return Run(parser, context);
+}
+
+auto Parse(const Parser &parser, std::string_view source, Context &context) -> Result
+{
+    context.Reset(source);
+    return Run(parser, context);
+}
+
+auto Match(const Parser &parser, std::string_view source) -> std::optional<std::size_t>
+{
+    Context context{source};
+    return Match(parser, source, context);
+}
+
+auto Match(const Parser &parser, std::string_view source, Context &context)
+    -> std::optional<std::size_t>
+{
+    context.Reset(source);
+    const Mode mode{context};
+    context.build = false;
+    const Result result = parser(context, 0);
+    if (const auto *success = std::get_if<Success>(&result))
+    {
+        return success->position;
+    }
+    return std::nullopt;
+}
+
+auto Evaluate(const Parser &parser, std::string_view source, Context &context)
+    -> std::optional<std::any>
+{
+    context.Reset(source);
+    const Mode mode{context};
+    context.build = false;
+    context.evaluate = true;
+    const Result result = parser(context, 0);
+    if (std::holds_alternative<Failure>(result))
+    {
+        return std::nullopt;
+    }
+    if (context.values.size() > 1)
+    {
+        throw std::runtime_error("Expected parse to produce at most one value but it "
+                                 "produced " +
+                                 std::to_string(context.values.size()));
+    }
+    std::any value;
+    if (!context.values.empty())
+    {
+        value = std::move(context.values.back());
+        context.values.clear();
+    }
+    return value;
+}
+
+auto Visit(const Parser &parser,
+           std::string_view source,
+           Visitor &visitor,
+           Context &context) -> std::optional<std::size_t>
+{
+    context.Reset(source);
+    const Mode mode{context};
+    context.build = false;
+    context.visitor = &visitor;
+    const Result result = parser(context, 0);
+    if (const auto *success = std::get_if<Success>(&result))
+    {
+        return success->position;
+    }
+    return std::nullopt;
+}
+
+auto Parse(const Parser &parser, std::string_view source, Context &context, Arena &arena)
+    -> const Result &
+{
+    context.Reset(source);
+    // Assigning a Result would keep the allocator of the assigned-to node list.
+    std::optional<Result> result;
+    {
+        const Mode mode{context};
+        context.resource = arena.Resource();
+        try
+        {
+            result.emplace(Run(parser, context));
+        }
+        catch (...)
+        {
+            context.Reset({});
+            throw;
+        }
+        // Memoized results live in the arena too, so they must go before it is
+        // released.
+        context.Reset({});
+    }
+    return arena.Keep(std::move(*result));
+}
+
+auto ParseBatch(const Parser &parser,
+                std::span<const std::string_view> inputs,
+                std::size_t jobs) -> std::vector<Result>
+{
+    std::vector<Context> contexts(Workers(jobs, inputs.size()));
+    std::vector<Result> results(inputs.size());
+    ParallelFor(inputs.size(),
+                jobs,
+                [&](std::size_t worker, std::size_t index)
+                { results[index] = Parse(parser, inputs[index], contexts[worker]); });
+    return results;
+}
+
+auto ParseParallel(const Parser &unit,
+                   const Parser &sync,
+                   std::string_view source,
+                   std::size_t jobs) -> Success
+{
+    const std::size_t pieces = Workers(jobs, source.size());
+    std::vector<Context> contexts(pieces);
+    std::vector<std::size_t> starts(pieces);
+    ParallelFor(pieces,
+                jobs,
+                [&](std::size_t worker, std::size_t index)
+                {
+                    const std::size_t target = source.size() * index / pieces;
+                    Context &context = contexts[worker];
+                    starts[index] =
+                        index == 0 ? 0 : Synchronize(sync, source, target, context);
+                });
+    // Nearby offsets may find the same split point.
+    starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+
+    std::vector<Units> chunks(starts.size());
+    ParallelFor(starts.size(),
+                jobs,
+                [&](std::size_t worker, std::size_t index)
+                {
+                    const std::size_t limit =
+                        index + 1 < starts.size() ? starts[index + 1] : source.size();
+                    chunks[index] =
+                        ParseUnits(unit, source, starts[index], limit, contexts[worker]);
+                });
+
+    // Stitch the pieces in order. A piece is only valid if the units before it end
+    // exactly where it starts; otherwise the units in between are parsed again, and
+    // pieces they overshoot are dropped.
+    Units stitched{{}, 0};
+    const auto append = [&stitched](Units &units)
+    {
+        stitched.nodes.insert(stitched.nodes.end(),
+                              std::make_move_iterator(units.nodes.begin()),
+                              std::make_move_iterator(units.nodes.end()));
+        stitched.end = units.end;
+        stitched.stopped = units.stopped;
+    };
+    Context &context = contexts.front();
+    for (std::size_t i = 0; i < chunks.size() && !stitched.stopped; i++)
+    {
+        if (stitched.end < starts[i])
+        {
+            Units gap = ParseUnits(unit, source, stitched.end, starts[i], context);
+            append(gap);
+        }
+        if (!stitched.stopped && stitched.end == starts[i])
+        {
+            append(chunks[i]);
+        }
+    }
+    if (!stitched.stopped && stitched.end < source.size())
+    {
+        Units rest = ParseUnits(unit, source, stitched.end, source.size(), context);
+        append(rest);
+    }
+    return Success{std::move(stitched.nodes), stitched.end};
+}
+
+auto Records::begin() -> Iterator
+{
+    if (!started)
+    {
+        started = true;
+        Next();
+    }
+    return Iterator{*this};
+}
+
+void Records::Next()
+{
+    current.reset();
+    // Records are independent, so nothing memoized for earlier ones is useful again.
+    context->Reset(source);
+    if (position >= source.size())
+    {
+        return;
+    }
+    Result result = Run(*parser, *context, position);
+    auto *success = std::get_if<Success>(&result);
+    if (success != nullptr && success->position > position)
+    {
+        position = success->position;
+        current.emplace(std::move(*success));
+    }
+}
+
+auto Clone(const Node &node, std::pmr::memory_resource *resource) -> Node
+{
+    if (std::holds_alternative<Terminal>(node))
+    {
+        return node;
+    }
+    const auto &nonterminal = std::get<NonTerminal>(node);
+    return NonTerminal{std::pmr::string(nonterminal.type, resource),
+                       Clone(nonterminal.children, resource)};
+}
+
+auto Clone(const Nodes &nodes, std::pmr::memory_resource *resource) -> Nodes
+{
+    Nodes copy{resource};
+    copy.reserve(nodes.size());
+    for (const auto &node : nodes)
+    {
+        copy.push_back(Clone(node, resource));
+    }
+    return copy;
+}
+
+Arena::Arena(std::size_t initial_size)
+    : buffer{std::make_unique<std::byte[]>(initial_size)},
+      resource{buffer.get(), initial_size}
+{
+}
+
+auto Arena::Resource() -> std::pmr::memory_resource * { return &resource; }
+
+auto Arena::Keep(Result &&result) -> const Result &
+{
+    if (std::holds_alternative<Failure>(result))
+    {
+        failures.push_back(std::move(result));
+        return failures.back();
+    }
+    // Placed in the arena and never destroyed: the nodes only own arena memory.
+    void *storage = resource.allocate(sizeof(Result), alignof(Result));
+    return *new (storage) Result{std::move(result)};
+}
+
+void Arena::Release()
+{
+    failures.clear();
+    resource.release();
+}
@@ -1,12 +1,24 @@
 #pragma once
 
 #include "ast.hpp"
+#include "profile.hpp"
+#include "trace.hpp"
 
+#include <any>
+#include <cstddef>
+#include <deque>
 #include <functional>
+#include <iterator>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <variant>
 #include <vector>
 
@@ -15,23 +27,35 @@ struct NonTerminal;
 
 using Node = std::variant<Terminal, NonTerminal>;
 
+// Node lists allocate from the memory resource of the Context that built them, which
+// is the default heap unless the parse runs in an Arena.
+using Nodes = std::pmr::vector<Node>;
+
 void Dump(const Node &node, int level = 0);
 
+// Terminals reference the span of input they matched, so the input must outlive
+// any tree produced from it.
 struct Terminal
 {
-    std::string value;
+    std::string_view value;
+
+    auto operator==(const Terminal &) const -> bool = default;
 };
 
 struct NonTerminal
 {
-    std::string type;
-    std::vector<Node> children;
+    std::pmr::string type;
+    Nodes children;
+
+    auto operator==(const NonTerminal &) const -> bool = default;
 };
 
+// Parsers append the nodes they match to Context::output and leave node empty. Parse()
+// moves the output into node once the whole parse succeeds.
 struct Success
 {
-    std::vector<Node> node;
-    std::string remainder;
+    Nodes node;
+    std::size_t position;
 };
 
 struct Failure
@@ -41,4 +65,345 @@ struct Failure
 
 using Result = std::variant<Success, Failure>;
 
-using Parser = std::function<Result(const std::string &)>;
+// Receives the matches of Visit() in document order. Only matches the parse has
+// committed to are reported, never those of alternatives it later abandons.
+class Visitor
+{
+  public:
+    Visitor() = default;
+    Visitor(const Visitor &) = default;
+    Visitor(Visitor &&) = default;
+    auto operator=(const Visitor &) -> Visitor & = default;
+    auto operator=(Visitor &&) -> Visitor & = default;
+    virtual ~Visitor() = default;
+
+    virtual void OnEnter(std::string_view /*rule*/, std::size_t /*offset*/) {}
+    virtual void OnExit(std::string_view /*rule*/,
+                        std::size_t /*start*/,
+                        std::size_t /*end*/)
+    {
+    }
+    virtual void OnToken(std::string_view /*token*/) {}
+};
+
+// A Visitor callback waiting to be delivered.
+struct Event
+{
+    enum class Kind
+    {
+        Enter,
+        Exit,
+        Token,
+    };
+
+    Kind kind;
+    std::string_view rule;
+    std::size_t start;
+    std::size_t end;
+};
+
+// Where the nodes or events of a memoized match are. They are not copied into the
+// memo table: a place follows them while enclosing rules wrap nodes into NonTerminals
+// and while backtracking moves them out of their stream, so that the memo table can
+// hand them out again.
+struct Place
+{
+    enum class Owner
+    {
+        // begin and end index the stream, Context::output or Context::events.
+        Stream,
+        // They index the children of the node at the place numbered index.
+        Node,
+        // They index the items held at index.
+        Held,
+        // The items went away with the stream, when it was handed over or delivered.
+        Lost,
+    };
+
+    Owner owner;
+    std::size_t index;
+    std::size_t begin;
+    std::size_t end;
+};
+
+// The places of the items of one stream, Nodes or events.
+template <typename Items>
+struct Placement
+{
+    // Items a parser backtracked over, kept because memoized matches refer to them.
+    struct Held
+    {
+        Items items;
+        // Places owned by the items, in the order they were placed.
+        std::vector<std::size_t> places;
+    };
+
+    std::vector<Place> places;
+    // Places owned by the stream, by increasing begin.
+    std::vector<std::size_t> placed;
+    std::vector<Held> held;
+
+    // Forgets the places of the items in the stream, which is about to be emptied.
+    void Lose()
+    {
+        for (const std::size_t place : placed)
+        {
+            places[place].owner = Place::Owner::Lost;
+        }
+        placed.clear();
+    }
+
+    void Clear()
+    {
+        places.clear();
+        placed.clear();
+        held.clear();
+    }
+};
+
+// A memoized result. The nodes and events of a success are at the places numbered
+// nodes and events, or it has none when the match appended none. The values it
+// produced while evaluating are copies, so actions whose values are expensive to copy
+// should share them, for example through a std::shared_ptr.
+struct Memo
+{
+    static constexpr std::size_t none = static_cast<std::size_t>(-1);
+
+    Result result;
+    std::size_t nodes = none;
+    std::vector<std::any> values;
+    std::size_t events = none;
+};
+
+// State shared by every parser invoked during a single parse. Parsers themselves are
+// immutable, so all mutable state lives here. A context may be reused for many parses
+// to keep its allocations, but it must not be shared between threads.
+struct Context
+{
+    std::string_view source;
+
+    // Packrat memo table, indexed by memo slot and then by input offset.
+    std::vector<std::unordered_map<std::size_t, Memo>> memo;
+
+    // End positions of memoized matches found while not building nodes, indexed like
+    // memo. They cannot be replayed when nodes are wanted.
+    std::vector<std::unordered_map<std::size_t, std::size_t>> recognized;
+
+    // Where the nodes of this parse are allocated.
+    std::pmr::memory_resource *resource = std::pmr::get_default_resource();
+
+    // Nodes matched so far, shared by every parser of the parse. On success a parser
+    // has appended its nodes; on failure it has left the output as it found it.
+    Nodes output;
+
+    // Places of the nodes of memoized matches, and of the nodes enclosing them.
+    Placement<Nodes> node_places;
+
+    // When false, parsers only recognize input and append no nodes. Predicates and
+    // Match() run this way.
+    bool build = true;
+
+    // Values produced by semantic actions, truncated on backtracking like output.
+    // Actions only run when evaluate is set, which Evaluate() does.
+    std::vector<std::any> values;
+    bool evaluate = false;
+
+    // Receives events while Visit() runs. Events are buffered while an enclosing
+    // parser may still backtrack over them, that is while backtrack is non-zero, and
+    // delivered as soon as it drops to zero.
+    Visitor *visitor = nullptr;
+    std::vector<Event> events;
+    std::size_t backtrack = 0;
+    // Places of the events of memoized matches.
+    Placement<std::vector<Event>> event_places;
+
+    // Receive the calls of instrumented rules when set.
+    Profile *profile = nullptr;
+    Tracer *tracer = nullptr;
+
+    // Prepares the context for a new parse of source, keeping allocated capacity. The
+    // mode goes back to building nodes, without actions or visitor.
+    void Reset(std::string_view input)
+    {
+        source = input;
+        build = true;
+        evaluate = false;
+        visitor = nullptr;
+        output.clear();
+        node_places.Clear();
+        values.clear();
+        events.clear();
+        event_places.Clear();
+        backtrack = 0;
+        for (auto &table : memo)
+        {
+            table.clear();
+        }
+        for (auto &table : recognized)
+        {
+            table.clear();
+        }
+        if (profile != nullptr)
+        {
+            profile->Begin();
+        }
+        if (tracer != nullptr)
+        {
+            tracer->Begin();
+        }
+    }
+};
+
+// Parsers match against context.source starting at the given offset. On success
+// the returned position is the offset just past the consumed input, and the matched
+// nodes have been appended to context.output.
+using Parser = std::function<Result(Context &, std::size_t)>;
+
+// Computes the value of a rule from the text it matched and the values produced by
+// the rules it matched, in order. The values may be moved from.
+using Action = std::function<std::any(std::string_view, std::span<std::any>)>;
+
+// Copies nodes and everything below them into resource. Copying a Node directly would
+// place the copy on the default heap.
+auto Clone(const Node &node, std::pmr::memory_resource *resource) -> Node;
+auto Clone(const Nodes &nodes, std::pmr::memory_resource *resource) -> Nodes;
+
+// Bump allocator that owns every node of a tree-mode parse. Nodes are never freed one
+// by one; the whole tree is dropped at once by Release() or by destroying the arena,
+// without visiting any node. The first block is kept across Release() so that an
+// arena reused for many parses does not return to the heap.
+class Arena
+{
+  public:
+    explicit Arena(std::size_t initial_size = 64 * 1024);
+    Arena(const Arena &) = delete;
+    Arena(Arena &&) = delete;
+    auto operator=(const Arena &) -> Arena & = delete;
+    auto operator=(Arena &&) -> Arena & = delete;
+    ~Arena() = default;
+
+    [[nodiscard]] auto Resource() -> std::pmr::memory_resource *;
+
+    // Keeps result alive until the arena is released, without ever destroying it.
+    auto Keep(Result &&result) -> const Result &;
+
+    // Drops every tree kept by the arena. References returned by Keep() dangle.
+    void Release();
+
+  private:
+    std::unique_ptr<std::byte[]> buffer;
+    std::pmr::monotonic_buffer_resource resource;
+    // Failures may own heap memory, so they are kept outside the arena.
+    std::deque<Result> failures;
+};
+
+auto Parse(const Parser &parser, std::string_view source) -> Result;
+auto Parse(const Parser &parser, std::string_view source, Context &context) -> Result;
+
+// Runs parser without building any nodes. Returns the end of the match, or nothing
+// if parser does not match.
+auto Match(const Parser &parser, std::string_view source) -> std::optional<std::size_t>;
+auto Match(const Parser &parser, std::string_view source, Context &context)
+    -> std::optional<std::size_t>;
+
+// Runs parser without building nodes, running semantic actions instead. Returns the
+// value produced at the top level, which is empty if there is none, or nothing if
+// parser does not match.
+auto Evaluate(const Parser &parser, std::string_view source, Context &context)
+    -> std::optional<std::any>;
+
+// Runs parser without building nodes, reporting its matches to visitor instead. Memory
+// use is bounded by how far the grammar can backtrack rather than by the input size.
+// Returns the end of the match, or nothing if parser does not match, in which case
+// visitor has seen the events of the part of the input committed to before failing.
+auto Visit(const Parser &parser,
+           std::string_view source,
+           Visitor &visitor,
+           Context &context) -> std::optional<std::size_t>;
+
+// The consecutive matches of a rule over an input made of independent records, such
+// as the lines of a log file. Records are parsed lazily, one per increment, and each
+// is released when the next is parsed, so memory is bounded by the largest record
+// rather than by the input. Iteration stops at the end of the input or at the first
+// offset where the rule fails or matches nothing; Position() then tells how far the
+// records reached. The parser, source and context must outlive the range.
+class Records
+{
+  public:
+    class Iterator
+    {
+      public:
+        using iterator_concept = std::input_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = Success;
+
+        Iterator() = default;
+
+        // The nodes of the current record and the offset just past it.
+        auto operator*() const -> const Success & { return *records->current; }
+
+        auto operator++() -> Iterator &
+        {
+            records->Next();
+            return *this;
+        }
+        void operator++(int) { records->Next(); }
+
+        auto operator==(std::default_sentinel_t /*end*/) const -> bool
+        {
+            return !records->current;
+        }
+
+      private:
+        friend class Records;
+
+        explicit Iterator(Records &records) : records{&records} {}
+
+        Records *records = nullptr;
+    };
+
+    Records(const Parser &parser, std::string_view source, Context &context)
+        : parser{&parser}, source{source}, context{&context}
+    {
+    }
+
+    // Parses the first record. A range can only be iterated once.
+    auto begin() -> Iterator;
+    static auto end() -> std::default_sentinel_t { return {}; }
+
+    // Offset just past the last record parsed so far.
+    [[nodiscard]] auto Position() const -> std::size_t { return position; }
+
+  private:
+    void Next();
+
+    const Parser *parser;
+    std::string_view source;
+    Context *context;
+    std::size_t position = 0;
+    std::optional<Success> current;
+    bool started = false;
+};
+
+// Parses every input with parser on up to jobs threads, one per hardware thread when
+// jobs is zero. Each thread reuses one Context for all the inputs it parses. Results
+// are returned in the order of the inputs, which must outlive them.
+auto ParseBatch(const Parser &parser,
+                std::span<const std::string_view> inputs,
+                std::size_t jobs) -> std::vector<Result>;
+
+// Parses source as consecutive matches of unit, like unit* but on up to jobs threads,
+// one per hardware thread when jobs is zero. The input is split where a match of sync
+// ends, found by scanning forward from evenly spaced offsets, and the pieces are
+// parsed concurrently. Pieces whose first unit did not start where the units before
+// them ended are parsed again, so the nodes are always those of a sequential parse.
+// Like Records, parsing stops at the first unit that fails or matches nothing.
+auto ParseParallel(const Parser &unit,
+                   const Parser &sync,
+                   std::string_view source,
+                   std::size_t jobs) -> Success;
+
+// Parses in tree mode: every node is allocated from arena and lives until the arena is
+// released.
+auto Parse(const Parser &parser, std::string_view source, Context &context, Arena &arena)
+    -> const Result &;
@@ -0,0 +1,87 @@
+#include "pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// The indices of one worker's share not claimed yet. Padded so that workers claiming
+// from their own shares do not contend on a cache line.
+struct alignas(64) Share
+{
+    std::atomic<std::size_t> next;
+    std::size_t end;
+};
+
+} // namespace
+
+auto Workers(std::size_t jobs, std::size_t count) -> std::size_t
+{
+    if (jobs == 0)
+    {
+        jobs = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+    }
+    return std::max<std::size_t>(std::min(jobs, count), 1);
+}
+
+void ParallelFor(std::size_t count,
+                 std::size_t jobs,
+                 const std::function<void(std::size_t worker, std::size_t index)> &task)
+{
+    const std::size_t workers = Workers(jobs, count);
+    std::vector<Share> shares(workers);
+    for (std::size_t i = 0; i < workers; i++)
+    {
+        shares[i].next = count * i / workers;
+        shares[i].end = count * (i + 1) / workers;
+    }
+
+    std::mutex mutex;
+    std::exception_ptr failure;
+    const auto work = [&](std::size_t worker)
+    {
+        try
+        {
+            // Claiming an index is a single increment, whether from the worker's own
+            // share or from a victim's, so every index is claimed exactly once.
+            for (std::size_t offset = 0; offset < workers; offset++)
+            {
+                Share &share = shares[(worker + offset) % workers];
+                for (std::size_t index = share.next++; index < share.end;
+                     index = share.next++)
+                {
+                    task(worker, index);
+                }
+            }
+        }
+        catch (...)
+        {
+            const std::lock_guard lock{mutex};
+            if (!failure)
+            {
+                failure = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (std::size_t worker = 1; worker < workers; worker++)
+    {
+        threads.emplace_back(work, worker);
+    }
+    work(0);
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    if (failure)
+    {
+        std::rethrow_exception(failure);
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Number of workers ParallelFor() uses for count tasks when asked for jobs workers,
+// where zero jobs means one per hardware thread. Never more than there are tasks, and
+// at least one.
+auto Workers(std::size_t jobs, std::size_t count) -> std::size_t;
+
+// Runs task(worker, index) once for every index below count, spread over Workers()
+// threads, the calling thread being worker 0. Each worker starts on its own contiguous
+// share of the indices and, once done, steals indices from the shares of the others,
+// so uneven tasks still keep every worker busy. Tasks of the same worker never run
+// concurrently, which lets them share per-worker state. Returns once every task has
+// run, rethrowing the first exception a task threw.
+void ParallelFor(std::size_t count,
+                 std::size_t jobs,
+                 const std::function<void(std::size_t worker, std::size_t index)> &task);
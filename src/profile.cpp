@@ -0,0 +1,225 @@
+#include "profile.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <utility>
+
+namespace
+{
+
+// Adds [start, end) to the disjoint spans and returns how many of its bytes they
+// already covered. The bytes they did not cover are added to fresh if given.
+auto Cover(std::map<std::size_t, std::size_t> &spans,
+           std::size_t start,
+           std::size_t end,
+           std::map<std::size_t, std::size_t> *fresh = nullptr) -> std::size_t
+{
+    std::size_t covered = 0;
+    auto it = spans.upper_bound(start);
+    if (it != spans.begin() && std::prev(it)->second >= start)
+    {
+        --it;
+    }
+    // Merge every span overlapping or touching the new one into it.
+    std::size_t first = start;
+    std::size_t last = end;
+    std::size_t uncovered = start;
+    while (it != spans.end() && it->first <= end)
+    {
+        if (fresh != nullptr && it->first > uncovered)
+        {
+            Cover(*fresh, uncovered, it->first);
+        }
+        uncovered = std::max(uncovered, it->second);
+        covered += std::max(std::min(it->second, end), start) -
+                   std::min(std::max(it->first, start), end);
+        first = std::min(first, it->first);
+        last = std::max(last, it->second);
+        it = spans.erase(it);
+    }
+    if (fresh != nullptr && uncovered < end)
+    {
+        Cover(*fresh, uncovered, end);
+    }
+    spans.emplace(first, last);
+    return covered;
+}
+
+// Returns how many bytes of [start, end) the disjoint spans cover.
+auto Overlap(const std::map<std::size_t, std::size_t> &spans,
+             std::size_t start,
+             std::size_t end) -> std::size_t
+{
+    std::size_t covered = 0;
+    auto it = spans.upper_bound(start);
+    if (it != spans.begin())
+    {
+        --it;
+    }
+    for (; it != spans.end() && it->first < end; ++it)
+    {
+        covered += std::max(std::min(it->second, end), start) -
+                   std::min(std::max(it->first, start), end);
+    }
+    return covered;
+}
+
+// Adds the disjoint spans of from to into, going over the smaller of the two.
+void Merge(std::map<std::size_t, std::size_t> &into,
+           std::map<std::size_t, std::size_t> &from)
+{
+    if (into.size() < from.size())
+    {
+        into.swap(from);
+    }
+    for (const auto &[start, end] : from)
+    {
+        Cover(into, start, end);
+    }
+}
+
+} // namespace
+
+void Profile::Begin()
+{
+    for (auto &spans : matched)
+    {
+        spans.clear();
+    }
+    std::fill(innermost.begin(), innermost.end(), none);
+    // A parse interrupted by an exception leaves its calls on the stack.
+    stack.clear();
+}
+
+void Profile::Enter(std::size_t rule, std::string_view name, std::size_t position)
+{
+    if (rules.size() <= rule)
+    {
+        rules.resize(rule + 1);
+        matched.resize(rule + 1);
+        innermost.resize(rule + 1, none);
+    }
+    if (rules[rule].name.empty())
+    {
+        rules[rule].name = name;
+    }
+    rules[rule].calls++;
+    const std::size_t outer = std::exchange(innermost[rule], stack.size());
+
+    const std::size_t parent = stack.empty() ? 0 : stack.back().call;
+    auto [it, inserted] = calls[parent].children.try_emplace(rule, calls.size());
+    if (inserted)
+    {
+        calls.push_back(Call{rule, parent, {}, {}});
+    }
+    stack.push_back(
+        Frame{rule, it->second, position, position, outer, {}, Clock::now(), {}});
+}
+
+void Profile::Exit(std::optional<std::size_t> end)
+{
+    const auto elapsed = Clock::now() - stack.back().start;
+    Frame frame = std::move(stack.back());
+    stack.pop_back();
+
+    RuleStatistics &statistics = rules[frame.rule];
+    const auto exclusive = elapsed - frame.children;
+    statistics.exclusive += exclusive;
+    calls[frame.call].exclusive += exclusive;
+    innermost[frame.rule] = frame.outer;
+    if (frame.outer == none)
+    {
+        statistics.inclusive += elapsed;
+    }
+    const std::size_t reach = end ? std::max(frame.reach, *end) : frame.reach;
+    if (!stack.empty())
+    {
+        stack.back().children += elapsed;
+        stack.back().reach = std::max(stack.back().reach, reach);
+    }
+
+    Spans fresh;
+    if (!end)
+    {
+        statistics.failures++;
+        statistics.abandoned += reach - frame.position;
+    }
+    else
+    {
+        statistics.successes++;
+        statistics.consumed += *end - frame.position;
+        // Input matched by the calls this one made was not scanned before it started.
+        const std::size_t covered =
+            Cover(matched[frame.rule], frame.position, *end, &fresh);
+        statistics.rescanned += covered - Overlap(frame.added, frame.position, *end);
+    }
+    if (frame.outer != none)
+    {
+        Spans &added = stack[frame.outer].added;
+        Merge(added, fresh);
+        Merge(added, frame.added);
+    }
+}
+
+void Profile::WriteTable(std::ostream &stream) const
+{
+    std::vector<const RuleStatistics *> called;
+    std::size_t width = 4;
+    for (const auto &statistics : rules)
+    {
+        if (statistics.calls > 0)
+        {
+            called.push_back(&statistics);
+            width = std::max(width, statistics.name.size());
+        }
+    }
+    std::stable_sort(called.begin(),
+                     called.end(),
+                     [](const RuleStatistics *left, const RuleStatistics *right)
+                     { return left->exclusive > right->exclusive; });
+
+    const auto milliseconds = [](std::chrono::nanoseconds duration)
+    { return std::chrono::duration<double, std::milli>(duration).count(); };
+    stream << std::left << std::setw(static_cast<int>(width)) << "rule" << std::right;
+    for (const char *column :
+         {"calls", "successes", "failures", "consumed", "rescanned", "abandoned"})
+    {
+        stream << std::setw(12) << column;
+    }
+    stream << std::setw(14) << "inclusive ms" << std::setw(14) << "exclusive ms" << '\n';
+    for (const auto *statistics : called)
+    {
+        stream << std::left << std::setw(static_cast<int>(width)) << statistics->name
+               << std::right << std::setw(12) << statistics->calls << std::setw(12)
+               << statistics->successes << std::setw(12) << statistics->failures
+               << std::setw(12) << statistics->consumed << std::setw(12)
+               << statistics->rescanned << std::setw(12) << statistics->abandoned
+               << std::fixed << std::setprecision(3) << std::setw(14)
+               << milliseconds(statistics->inclusive) << std::setw(14)
+               << milliseconds(statistics->exclusive) << '\n';
+    }
+}
+
+void Profile::WriteFolded(std::ostream &stream) const
+{
+    for (std::size_t i = 1; i < calls.size(); i++)
+    {
+        std::string line;
+        for (std::size_t call = i; call != 0; call = calls[call].parent)
+        {
+            const std::string &name = rules[calls[call].rule].name;
+            line.insert(0, line.empty() ? name : name + ";");
+        }
+        stream << line << ' ' << calls[i].exclusive.count() << '\n';
+    }
+}
+
+void Profile::Clear()
+{
+    rules.clear();
+    matched.clear();
+    innermost.clear();
+    stack.clear();
+    calls.resize(1);
+    calls.front().children.clear();
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// What a Profile recorded for one rule.
+struct RuleStatistics
+{
+    std::string name;
+    std::size_t calls = 0;
+    std::size_t successes = 0;
+    std::size_t failures = 0;
+    // Bytes matched by successful calls.
+    std::size_t consumed = 0;
+    // Bytes matched by successful calls that an earlier successful call of the same
+    // rule had already matched during the parse, which is work repeated after
+    // backtracking. Calls of a recursive rule do not count what the calls nested in
+    // them matched.
+    std::size_t rescanned = 0;
+    // Bytes between the start of failed calls and the furthest end matched by a rule
+    // they called, a lower bound on the input they examined in vain.
+    std::size_t abandoned = 0;
+    // Time spent in the rule including the rules it called, counted once for
+    // recursive calls, and excluding them.
+    std::chrono::nanoseconds inclusive{0};
+    std::chrono::nanoseconds exclusive{0};
+};
+
+// Per-rule counters collected while parsing with the rules of a collection generated
+// with Options::instrument and a Context pointing at the profile. Counters add up
+// over every parse until Clear(). A profile is tied to the collection that filled it
+// and, like a Context, must not be shared between threads.
+class Profile
+{
+  public:
+    // Starts a new parse. Context::Reset() calls it.
+    void Begin();
+
+    void Enter(std::size_t rule, std::string_view name, std::size_t position);
+    // Ends the innermost call, which matched up to end, or failed when end is empty.
+    void Exit(std::optional<std::size_t> end);
+
+    // Statistics indexed by rule, including rules that were never called.
+    [[nodiscard]] auto Rules() const -> const std::vector<RuleStatistics> &
+    {
+        return rules;
+    }
+
+    // Writes one row per called rule, the most expensive first by exclusive time.
+    void WriteTable(std::ostream &stream) const;
+
+    // Writes the exclusive time in nanoseconds of every call stack, one stack per line
+    // with rules separated by semicolons, as flame graph tools expect.
+    void WriteFolded(std::ostream &stream) const;
+
+    void Clear();
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    // A node of the call tree, which merges the calls made through the same stack.
+    struct Call
+    {
+        std::size_t rule;
+        std::size_t parent;
+        std::map<std::size_t, std::size_t> children;
+        std::chrono::nanoseconds exclusive{0};
+    };
+
+    using Spans = std::map<std::size_t, std::size_t>;
+
+    static constexpr std::size_t none = static_cast<std::size_t>(-1);
+
+    struct Frame
+    {
+        std::size_t rule;
+        std::size_t call;
+        std::size_t position;
+        // Furthest end matched by the call or the calls it made so far.
+        std::size_t reach;
+        // Index in the stack of the innermost enclosing call of the same rule.
+        std::size_t outer;
+        // Input first matched during this call by calls of the same rule it made,
+        // which this call does not scan again but builds on.
+        Spans added;
+        Clock::time_point start;
+        std::chrono::nanoseconds children{0};
+    };
+
+    std::vector<RuleStatistics> rules;
+    // Disjoint spans of input each rule has matched during the current parse, as a
+    // map from start to end.
+    std::vector<Spans> matched;
+    // Index in the stack of the innermost call of each rule, or none.
+    std::vector<std::size_t> innermost;
+    std::vector<Frame> stack;
+    // The root, at index 0, stands for the caller of the parse.
+    std::vector<Call> calls{Call{0, 0, {}, {}}};
+};
@@ -0,0 +1,234 @@
+#include "reader.hpp"
+
+#include "grammar.hpp"
+#include "parser.hpp"
+#include "vm.hpp"
+
+#include <stdexcept>
+
+namespace
+{
+
+auto Children(const Node &node) -> const Nodes &
+{
+    return std::get<NonTerminal>(node).children;
+}
+
+auto Type(const Node &node) -> std::string_view
+{
+    if (std::holds_alternative<NonTerminal>(node))
+    {
+        return std::get<NonTerminal>(node).type;
+    }
+    return {};
+}
+
+// Concatenates the terminals below node, ignoring any trailing Spacing.
+void AppendText(const Node &node, std::string &text)
+{
+    if (std::holds_alternative<Terminal>(node))
+    {
+        text += std::get<Terminal>(node).value;
+        return;
+    }
+    for (const auto &child : Children(node))
+    {
+        if (Type(child) != "Spacing")
+        {
+            AppendText(child, text);
+        }
+    }
+}
+
+auto ToChar(const Node &node) -> std::string
+{
+    std::string text;
+    AppendText(node, text);
+    if (text.size() < 2 || text[0] != '\\')
+    {
+        return text;
+    }
+    switch (text[1])
+    {
+    case 'n':
+        return "\n";
+    case 'r':
+        return "\r";
+    case 't':
+        return "\t";
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+        return std::string(1, static_cast<char>(std::stoi(text.substr(1), nullptr, 8)));
+    default:
+        return text.substr(1);
+    }
+}
+
+auto ToIdentifier(const Node &node) -> ast::Identifier
+{
+    std::string name;
+    AppendText(node, name);
+    return ast::Identifier(name);
+}
+
+auto ToLiteral(const Node &node) -> ast::Literal
+{
+    std::string value;
+    for (const auto &child : Children(node))
+    {
+        if (Type(child) == "Char")
+        {
+            value += ToChar(child);
+        }
+    }
+    return ast::Literal(value);
+}
+
+auto ToClass(const Node &node) -> ast::Class
+{
+    std::vector<ast::Range> ranges;
+    std::vector<ast::Literal> literals;
+    for (const auto &child : Children(node))
+    {
+        if (Type(child) != "Range")
+        {
+            continue;
+        }
+        const auto &bounds = Children(child);
+        if (bounds.size() == 3)
+        {
+            ranges.emplace_back(ToChar(bounds[0]), ToChar(bounds[2]));
+        }
+        else
+        {
+            literals.emplace_back(ToChar(bounds[0]));
+        }
+    }
+    return {ranges, literals};
+}
+
+auto ToExpression(const Node &node) -> ast::Expression;
+
+auto ToPrimary(const Node &node) -> ast::Expression
+{
+    const auto &children = Children(node);
+    const auto type = Type(children[0]);
+    if (type == "Identifier")
+    {
+        return ToIdentifier(children[0]);
+    }
+    if (type == "OPEN")
+    {
+        return ToExpression(children[1]);
+    }
+    if (type == "Literal")
+    {
+        return ToLiteral(children[0]);
+    }
+    if (type == "Class")
+    {
+        return ToClass(children[0]);
+    }
+    return ast::Dot();
+}
+
+auto ToSuffix(const Node &node) -> ast::Expression
+{
+    const auto &children = Children(node);
+    ast::Expression primary = ToPrimary(children[0]);
+    if (children.size() == 1)
+    {
+        return primary;
+    }
+    const auto suffix = Type(children[1]);
+    if (suffix == "QUESTION")
+    {
+        return Box(ast::Optional(std::move(primary)));
+    }
+    if (suffix == "STAR")
+    {
+        return Box(ast::ZeroOrMore(std::move(primary)));
+    }
+    return Box(ast::OneOrMore(std::move(primary)));
+}
+
+auto ToPrefix(const Node &node) -> ast::Expression
+{
+    const auto &children = Children(node);
+    ast::Expression suffix = ToSuffix(children.back());
+    if (children.size() == 1)
+    {
+        return suffix;
+    }
+    if (Type(children[0]) == "AND")
+    {
+        return Box(ast::And(std::move(suffix)));
+    }
+    return Box(ast::Not(std::move(suffix)));
+}
+
+auto ToSequence(const Node &node) -> ast::Expression
+{
+    const auto &children = Children(node);
+    if (children.size() == 1)
+    {
+        return ToPrefix(children[0]);
+    }
+    ast::Sequence sequence;
+    for (const auto &child : children)
+    {
+        sequence.children.push_back(ToPrefix(child));
+    }
+    return Box(std::move(sequence));
+}
+
+auto ToExpression(const Node &node) -> ast::Expression
+{
+    std::vector<ast::Expression> sequences;
+    for (const auto &child : Children(node))
+    {
+        if (Type(child) == "Sequence")
+        {
+            sequences.push_back(ToSequence(child));
+        }
+    }
+    if (sequences.size() == 1)
+    {
+        return std::move(sequences[0]);
+    }
+    ast::Alternative alternative;
+    alternative.children = std::move(sequences);
+    return Box(std::move(alternative));
+}
+
+} // namespace
+
+auto ReadGrammar(std::string_view source) -> ast::Grammar
+{
+    static const vm::Program peg = vm::Compile(GetPegGrammarAST());
+
+    const Result result = peg.Parse("Grammar", source);
+    if (std::holds_alternative<Failure>(result))
+    {
+        throw std::runtime_error("Failed to parse grammar");
+    }
+
+    ast::Grammar grammar;
+    const auto &root = std::get<Success>(result).node[0];
+    for (const auto &child : Children(root))
+    {
+        if (Type(child) != "Definition")
+        {
+            continue;
+        }
+        const auto &parts = Children(child);
+        grammar.definitions.emplace_back(ToIdentifier(parts[0]), ToExpression(parts[2]));
+    }
+    return grammar;
+}
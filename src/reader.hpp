@@ -0,0 +1,9 @@
+#pragma once
+
+#include "ast.hpp"
+
+#include <string_view>
+
+// Parses PEG grammar text with the bootstrap grammar from grammar.hpp and converts the
+// resulting tree into an ast::Grammar. Throws if the text is not a valid grammar.
+auto ReadGrammar(std::string_view source) -> ast::Grammar;
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "parser.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <string_view>
+
+// Compile-time counterparts of the combinator:: parsers. Every parser is a distinct
+// type with a static Match function, so a grammar known at compile time is composed
+// without std::function and can be inlined completely. Trees have the same shape as
+// those built by the combinator:: parsers.
+//
+// Match appends the matched nodes and advances position on success. On failure it
+// leaves both unchanged.
+//
+// Recursive grammars name their rules with structs, which may be forward declared:
+//
+//     struct Value;
+//     struct Sum : Def<"Sum", Seq<Value, Star<Seq<Lit<"+">, Value>>>> {};
+//     struct Value
+//         : Def<"Value", Alt<Plus<Rng<'0', '9'>>, Seq<Lit<"(">, Sum, Lit<")">>>> {};
+namespace static_combinator
+{
+
+template <std::size_t N> struct FixedString
+{
+    constexpr FixedString(const char (&string)[N]) { std::copy_n(string, N, value); }
+
+    [[nodiscard]] constexpr auto View() const -> std::string_view
+    {
+        return {value, N - 1};
+    }
+
+    char value[N];
+};
+
+template <FixedString Value> struct Lit
+{
+    static auto Match(Context &context, std::size_t &position, Nodes &nodes)
+        -> bool
+    {
+        constexpr std::string_view value = Value.View();
+        const std::string_view input = context.source.substr(position);
+        if (!input.starts_with(value))
+        {
+            return false;
+        }
+        nodes.push_back(Terminal{input.substr(0, value.size())});
+        position += value.size();
+        return true;
+    }
+};
+
+template <char Start, char End> struct Rng
+{
+    static auto Match(Context &context, std::size_t &position, Nodes &nodes)
+        -> bool
+    {
+        if (position >= context.source.size())
+        {
+            return false;
+        }
+        const char c = context.source[position];
+        if (c < Start || c > End)
+        {
+            return false;
+        }
+        nodes.push_back(Terminal{context.source.substr(position, 1)});
+        position++;
+        return true;
+    }
+};
+
+struct Any
+{
+    static auto Match(Context &context, std::size_t &position, Nodes &nodes)
+        -> bool
+    {
+        if (position >= context.source.size())
+        {
+            return false;
+        }
+        nodes.push_back(Terminal{context.source.substr(position, 1)});
+        position++;
+        return true;
+    }
+};
+
+template <typename... Parsers> struct Seq
+{
+    static_assert(sizeof...(Parsers) > 0, "Expected sequence to contain a parser");
+
+    static auto Match(Context &context, std::size_t &position, Nodes &nodes)
+        -> bool
+    {
+        const std::size_t start = position;
+        const std::size_t mark = nodes.size();
+        if ((Parsers::Match(context, position, nodes) && ...))
+        {
+            return true;
+        }
+        position = start;
+        nodes.resize(mark);
+        return false;
+    }
+};
+
+template <typename... Parsers> struct Alt
+{
+    static_assert(sizeof...(Parsers) > 0, "Expected alternative to contain a parser");
+
+    static auto Match(Context &context, std::size_t &position, Nodes &nodes)
+        -> bool
+    {
+        return (Parsers::Match(context, position, nodes) || ...);
+    }
+};
+
+template <typename Parser> struct Opt
+{
+    static auto Match(Context &context, std::size_t &position, Nodes &nodes)
+        -> bool
+    {
+        Parser::Match(context, position, nodes);
+        return true;
+    }
+};
+
+template <typename Parser> struct Star
+{
+    static auto Match(Context &context, std::size_t &position, Nodes &nodes)
+        -> bool
+    {
+        while (Parser::Match(context, position, nodes))
+        {
+        }
+        return true;
+    }
+};
+
+template <typename Parser> struct Plus
+{
+    static auto Match(Context &context, std::size_t &position, Nodes &nodes)
+        -> bool
+    {
+        if (!Parser::Match(context, position, nodes))
+        {
+            return false;
+        }
+        return Star<Parser>::Match(context, position, nodes);
+    }
+};
+
+template <typename Parser> struct And
+{
+    static auto Match(Context &context, std::size_t &position, Nodes &nodes)
+        -> bool
+    {
+        std::size_t lookahead = position;
+        const std::size_t mark = nodes.size();
+        const bool matched = Parser::Match(context, lookahead, nodes);
+        nodes.resize(mark);
+        return matched;
+    }
+};
+
+template <typename Parser> struct Not
+{
+    static auto Match(Context &context, std::size_t &position, Nodes &nodes)
+        -> bool
+    {
+        return !And<Parser>::Match(context, position, nodes);
+    }
+};
+
+template <FixedString Type, typename Parser> struct Def
+{
+    static auto Match(Context &context, std::size_t &position, Nodes &nodes)
+        -> bool
+    {
+        Nodes children;
+        if (!Parser::Match(context, position, children))
+        {
+            return false;
+        }
+        nodes.push_back(NonTerminal{std::pmr::string(Type.View()), std::move(children)});
+        return true;
+    }
+};
+
+template <typename Parser> auto Parse(std::string_view source) -> Result
+{
+    Context context{source};
+    std::size_t position = 0;
+    Nodes nodes;
+    if (!Parser::Match(context, position, nodes))
+    {
+        return Result{Failure{"No match"}};
+    }
+    return Result{Success{std::move(nodes), position}};
+}
+
+} // namespace static_combinator
@@ -0,0 +1,91 @@
+#include "tape.hpp"
+
+#include <iterator>
+#include <utility>
+
+auto Tape::Cursor::Type() const -> std::string_view
+{
+    if (IsToken())
+    {
+        return {};
+    }
+    return tape->rules[Entry().rule];
+}
+
+auto Tape::Cursor::Value() const -> std::string_view
+{
+    return tape->source.substr(Entry().start, Entry().end - Entry().start);
+}
+
+auto Tape::Cursor::FirstChild() const -> std::optional<Cursor>
+{
+    if (Entry().size == 1)
+    {
+        return std::nullopt;
+    }
+    return Cursor{*tape, index + 1, index + Entry().size};
+}
+
+auto Tape::Cursor::NextSibling() const -> std::optional<Cursor>
+{
+    const std::size_t next = index + Entry().size;
+    if (next >= limit)
+    {
+        return std::nullopt;
+    }
+    return Cursor{*tape, next, limit};
+}
+
+auto Tape::Root() const -> std::optional<Cursor>
+{
+    if (entries.empty())
+    {
+        return std::nullopt;
+    }
+    return Cursor{*this, 0, entries.size()};
+}
+
+auto Tape::ToNodes() const -> Nodes
+{
+    return ToNodes(0, entries.size());
+}
+
+auto Tape::ToNodes(std::size_t begin, std::size_t end) const -> Nodes
+{
+    Nodes nodes;
+    for (std::size_t index = begin; index < end; index += entries[index].size)
+    {
+        const TapeEntry &entry = entries[index];
+        const std::size_t length = entry.end - entry.start;
+        if (entry.rule == Token)
+        {
+            nodes.emplace_back(std::in_place_type<Terminal>,
+                               source.substr(entry.start, length));
+            continue;
+        }
+        const ast::Shape shape = shapes[entry.rule];
+        if (shape == ast::Shape::Skip)
+        {
+            continue;
+        }
+        if (shape == ast::Shape::Token)
+        {
+            nodes.emplace_back(std::in_place_type<Terminal>,
+                               source.substr(entry.start, length));
+            continue;
+        }
+        Nodes children = ToNodes(index + 1, index + entry.size);
+        if (shape == ast::Shape::Inline ||
+            (shape == ast::Shape::Collapse && children.size() == 1))
+        {
+            nodes.insert(nodes.end(),
+                         std::make_move_iterator(children.begin()),
+                         std::make_move_iterator(children.end()));
+            continue;
+        }
+        nodes.emplace_back(std::in_place_type<NonTerminal>,
+                           std::pmr::string(rules[entry.rule]),
+                           std::move(children));
+    }
+    return nodes;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "ast.hpp"
+#include "parser.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One node of a Tape. Entries are stored in pre-order, so a node's children follow it
+// directly and its next sibling is size entries further on. The exit of a node is
+// implied by its size.
+struct TapeEntry
+{
+    // Index into the rule names, or Tape::Token for a terminal.
+    std::uint32_t rule;
+    // Number of entries in this subtree, including this one. Inputs of many gigabytes
+    // can produce more entries than 32 bits can count.
+    std::size_t size;
+    std::size_t start;
+    std::size_t end;
+};
+
+// A parse tree flattened into one contiguous array of entries. It needs a single
+// allocation however many nodes it holds and is walked with cursors instead of
+// pointers. Like Terminal, it references the input and the rule names it was built
+// from, which must outlive it.
+class Tape
+{
+  public:
+    static constexpr std::uint32_t Token = std::numeric_limits<std::uint32_t>::max();
+
+    // A position in the tape. Cursors are cheap to copy and only move forward.
+    class Cursor
+    {
+      public:
+        [[nodiscard]] auto IsToken() const -> bool { return Entry().rule == Token; }
+
+        [[nodiscard]] auto Rule() const -> std::uint32_t { return Entry().rule; }
+
+        // Rule name for non-terminals, empty for terminals.
+        [[nodiscard]] auto Type() const -> std::string_view;
+
+        // The span of input this node matched.
+        [[nodiscard]] auto Value() const -> std::string_view;
+
+        [[nodiscard]] auto Start() const -> std::size_t { return Entry().start; }
+        [[nodiscard]] auto End() const -> std::size_t { return Entry().end; }
+
+        [[nodiscard]] auto FirstChild() const -> std::optional<Cursor>;
+        [[nodiscard]] auto NextSibling() const -> std::optional<Cursor>;
+
+      private:
+        friend class Tape;
+
+        Cursor(const Tape &tape, std::size_t index, std::size_t limit)
+            : tape{&tape}, index{index}, limit{limit}
+        {
+        }
+
+        [[nodiscard]] auto Entry() const -> const TapeEntry &
+        {
+            return tape->entries[index];
+        }
+
+        const Tape *tape;
+        std::size_t index;
+        // One past the last entry of the parent's subtree.
+        std::size_t limit;
+    };
+
+    // The rule names and shapes are not copied: they belong to the vm::Program that
+    // built the tape, which must outlive it like the source. Moving the program is
+    // fine, as its vectors keep their elements where they are.
+    Tape(std::string_view source,
+         std::span<const std::string> rules,
+         std::span<const ast::Shape> shapes)
+        : source{source}, rules{rules}, shapes{shapes}
+    {
+    }
+
+    // The first top-level node, if any. Cursors walk every rule match whatever the
+    // rule's shape.
+    [[nodiscard]] auto Root() const -> std::optional<Cursor>;
+
+    // Builds the tree vm::Program::Parse() returns, applying rule shapes.
+    [[nodiscard]] auto ToNodes() const -> Nodes;
+
+    std::vector<TapeEntry> entries;
+    // Offset just past the consumed input.
+    std::size_t position = 0;
+
+  private:
+    [[nodiscard]] auto ToNodes(std::size_t begin, std::size_t end) const -> Nodes;
+
+    std::string_view source;
+    std::span<const std::string> rules;
+    std::span<const ast::Shape> shapes;
+};
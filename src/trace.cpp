@@ -0,0 +1,83 @@
+#include "trace.hpp"
+
+#include <iomanip>
+#include <stdexcept>
+
+namespace
+{
+
+// Trace timestamps are in microseconds.
+void WriteMicroseconds(std::ostream &stream, std::chrono::nanoseconds duration)
+{
+    const auto count = duration.count();
+    const char fill = stream.fill('0');
+    stream << count / 1000 << '.' << std::setw(3) << count % 1000;
+    stream.fill(fill);
+}
+
+} // namespace
+
+Tracer::Tracer(std::ostream &stream, const TraceOptions &options)
+    : stream{&stream}, options{options}
+{
+    if (options.every == 0)
+    {
+        throw std::runtime_error("Expected to trace one in every 1 or more calls");
+    }
+    stream << "{\"traceEvents\": [";
+}
+
+Tracer::~Tracer() { Finish(); }
+
+void Tracer::Begin()
+{
+    // A parse interrupted by an exception leaves its calls on the stack.
+    stack.clear();
+}
+
+void Tracer::Enter()
+{
+    bool recorded = false;
+    if (!finished && stack.size() <= options.max_depth)
+    {
+        recorded = eligible++ % options.every == 0;
+    }
+    stack.push_back(Frame{recorded, recorded ? Clock::now() : Clock::time_point{}});
+}
+
+void Tracer::Exit(std::string_view rule,
+                  std::size_t position,
+                  std::optional<std::size_t> end)
+{
+    const Frame frame = stack.back();
+    stack.pop_back();
+    if (!frame.recorded || finished)
+    {
+        return;
+    }
+    const auto now = Clock::now();
+
+    auto &out = *stream;
+    out << (written++ == 0 ? "\n" : ",\n") << "{\"name\": \"" << rule
+        << "\", \"cat\": \"" << (end ? "match" : "fail")
+        << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": ";
+    WriteMicroseconds(out, frame.start - origin);
+    out << ", \"dur\": ";
+    WriteMicroseconds(out, now - frame.start);
+    out << ", \"args\": {\"offset\": " << position;
+    if (end)
+    {
+        out << ", \"end\": " << *end;
+    }
+    out << ", \"depth\": " << stack.size() << "}}";
+}
+
+void Tracer::Finish()
+{
+    if (!finished)
+    {
+        finished = true;
+        *stream << "\n]}\n";
+        stream->flush();
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+struct TraceOptions
+{
+    // Calls nested deeper than this are not recorded, the rule a parse starts with
+    // being at depth 0.
+    std::size_t max_depth = std::numeric_limits<std::size_t>::max();
+
+    // Records one in every this many calls within max_depth.
+    std::size_t every = 1;
+};
+
+// Writes the calls of instrumented rules to stream as a trace in the Chrome trace
+// event format, which chrome://tracing and Perfetto open. Each call becomes a complete
+// event named after its rule, in category match or fail, with the offsets it matched
+// and its depth as arguments. Calls are written as they return, so memory stays
+// constant whatever the length of the trace.
+//
+// Set on a Context, a tracer records the calls of rules generated with
+// Options::instrument over every parse until it is finished. Like a Context, it must
+// not be shared between threads.
+class Tracer
+{
+  public:
+    explicit Tracer(std::ostream &stream, const TraceOptions &options = {});
+    Tracer(const Tracer &) = delete;
+    Tracer(Tracer &&) = delete;
+    auto operator=(const Tracer &) -> Tracer & = delete;
+    auto operator=(Tracer &&) -> Tracer & = delete;
+    ~Tracer();
+
+    // Starts a new parse. Context::Reset() calls it.
+    void Begin();
+
+    void Enter();
+    // Ends the innermost call, of rule, which started at position and matched up to
+    // end, or failed when end is empty.
+    void Exit(std::string_view rule,
+              std::size_t position,
+              std::optional<std::size_t> end);
+
+    // Completes the trace. Called by the destructor if not before; nothing is
+    // recorded afterwards.
+    void Finish();
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Frame
+    {
+        bool recorded;
+        Clock::time_point start;
+    };
+
+    std::ostream *stream;
+    TraceOptions options;
+    Clock::time_point origin = Clock::now();
+    std::vector<Frame> stack;
+    // Calls within max_depth so far, which decides the ones sampled.
+    std::size_t eligible = 0;
+    std::size_t written = 0;
+    bool finished = false;
+};
@@ -0,0 +1,70 @@
+#include "trie.hpp"
+
+#include <algorithm>
+
+Trie::Trie(const std::vector<std::string> &strings) : nodes(1)
+{
+    for (std::size_t index = 0; index < strings.size(); index++)
+    {
+        std::uint32_t current = 0;
+        nodes[current].earliest = std::min(nodes[current].earliest, index);
+        for (const char c : strings[index])
+        {
+            const auto byte = static_cast<unsigned char>(c);
+            auto &edges = nodes[current].edges;
+            auto edge = std::lower_bound(edges.begin(),
+                                         edges.end(),
+                                         byte,
+                                         [](const auto &edge, unsigned char byte)
+                                         { return edge.first < byte; });
+            if (edge == edges.end() || edge->first != byte)
+            {
+                const auto next = static_cast<std::uint32_t>(nodes.size());
+                edges.insert(edge, {byte, next});
+                nodes.emplace_back();
+                current = next;
+            }
+            else
+            {
+                current = edge->second;
+            }
+            nodes[current].earliest = std::min(nodes[current].earliest, index);
+        }
+        nodes[current].match = std::min(nodes[current].match, index);
+    }
+}
+
+auto Trie::Child(const TrieNode &node, unsigned char byte) const -> const TrieNode *
+{
+    const auto edge = std::lower_bound(node.edges.begin(),
+                                       node.edges.end(),
+                                       byte,
+                                       [](const auto &edge, unsigned char byte)
+                                       { return edge.first < byte; });
+    if (edge == node.edges.end() || edge->first != byte)
+    {
+        return nullptr;
+    }
+    return &nodes[edge->second];
+}
+
+auto Trie::Match(std::string_view input) const -> std::optional<std::size_t>
+{
+    std::size_t best = None;
+    const TrieNode *node = &nodes[0];
+    for (std::size_t i = 0; node != nullptr; i++)
+    {
+        best = std::min(best, node->match);
+        // Nothing further down can be earlier than what was already found.
+        if (node->earliest >= best || i == input.size())
+        {
+            break;
+        }
+        node = Child(*node, static_cast<unsigned char>(input[i]));
+    }
+    if (best == None)
+    {
+        return std::nullopt;
+    }
+    return best;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A byte trie over an ordered list of strings. Match finds the earliest string in the
+// list that prefixes the input, which is the string an ordered choice of literals
+// would match, in time bounded by the longest string rather than the list length.
+class Trie
+{
+  public:
+    explicit Trie(const std::vector<std::string> &strings);
+
+    // Returns the index of the earliest string that prefixes input.
+    [[nodiscard]] auto Match(std::string_view input) const -> std::optional<std::size_t>;
+
+  private:
+    static constexpr std::size_t None = static_cast<std::size_t>(-1);
+
+    struct TrieNode
+    {
+        // Outgoing edges sorted by byte.
+        std::vector<std::pair<unsigned char, std::uint32_t>> edges;
+        // Index of the earliest string ending here.
+        std::size_t match = None;
+        // Index of the earliest string ending here or below.
+        std::size_t earliest = None;
+    };
+
+    [[nodiscard]] auto Child(const TrieNode &node, unsigned char byte) const
+        -> const TrieNode *;
+
+    std::vector<TrieNode> nodes;
+};
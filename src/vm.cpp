@@ -0,0 +1,879 @@
+#include "vm.hpp"
+
+#include "box.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+
+namespace vm
+{
+
+template <typename> inline constexpr bool AlwaysFalse = false;
+
+namespace
+{
+
+class Compiler
+{
+  public:
+    explicit Compiler(Program &program) : program{program} {}
+
+    auto Emit(Opcode opcode, std::uint32_t argument = 0) -> std::uint32_t
+    {
+        program.code.push_back({opcode, argument});
+        return static_cast<std::uint32_t>(program.code.size() - 1);
+    }
+
+    [[nodiscard]] auto Here() const -> std::uint32_t
+    {
+        return static_cast<std::uint32_t>(program.code.size());
+    }
+
+    void Patch(std::uint32_t instruction, std::uint32_t target)
+    {
+        program.code[instruction].argument = target;
+    }
+
+    void EmitLiteral(const std::string &value)
+    {
+        if (value.size() == 1)
+        {
+            Emit(Opcode::Char, static_cast<unsigned char>(value[0]));
+            return;
+        }
+        program.literals.push_back(value);
+        Emit(Opcode::Literal, static_cast<std::uint32_t>(program.literals.size() - 1));
+    }
+
+    void EmitSet(const CharSet &set)
+    {
+        program.sets.push_back(set);
+        Emit(Opcode::Set, static_cast<std::uint32_t>(program.sets.size() - 1));
+    }
+
+    // Emits an ordered choice between the given alternatives.
+    template <typename Alternatives, typename EmitAlternative>
+    void EmitChoice(const Alternatives &alternatives, EmitAlternative emit)
+    {
+        std::vector<std::uint32_t> commits;
+        for (std::size_t i = 0; i + 1 < alternatives.size(); i++)
+        {
+            const auto choice = Emit(Opcode::Choice);
+            emit(alternatives[i]);
+            commits.push_back(Emit(Opcode::Commit));
+            Patch(choice, Here());
+        }
+        emit(alternatives.back());
+        for (const auto commit : commits)
+        {
+            Patch(commit, Here());
+        }
+    }
+
+    void EmitStar(const ast::Expression &child)
+    {
+        if (const auto set = SingleByteSet(child))
+        {
+            program.sets.push_back(*set);
+            Emit(Opcode::Span, static_cast<std::uint32_t>(program.sets.size() - 1));
+            return;
+        }
+        const auto choice = Emit(Opcode::Choice);
+        const auto body = Here();
+        EmitExpression(child);
+        Emit(Opcode::PartialCommit, body);
+        Patch(choice, Here());
+    }
+
+    void EmitExpression(const ast::Expression &expression)
+    {
+        std::visit(
+            [this](auto &&expression)
+            {
+                using T = std::decay_t<decltype(expression)>;
+                if constexpr (std::is_same_v<T, Box<ast::Sequence>>)
+                {
+                    for (const auto &child : expression->children)
+                    {
+                        EmitExpression(child);
+                    }
+                }
+                else if constexpr (std::is_same_v<T, Box<ast::Optional>>)
+                {
+                    const auto choice = Emit(Opcode::Choice);
+                    EmitExpression(expression->child);
+                    const auto commit = Emit(Opcode::Commit);
+                    Patch(choice, Here());
+                    Patch(commit, Here());
+                }
+                else if constexpr (std::is_same_v<T, Box<ast::ZeroOrMore>>)
+                {
+                    EmitStar(expression->child);
+                }
+                else if constexpr (std::is_same_v<T, Box<ast::OneOrMore>>)
+                {
+                    EmitExpression(expression->child);
+                    EmitStar(expression->child);
+                }
+                else if constexpr (std::is_same_v<T, Box<ast::And>>)
+                {
+                    const auto choice = Emit(Opcode::Choice);
+                    EmitExpression(expression->child);
+                    const auto commit = Emit(Opcode::BackCommit);
+                    Patch(choice, Here());
+                    Emit(Opcode::Fail);
+                    Patch(commit, Here());
+                }
+                else if constexpr (std::is_same_v<T, Box<ast::Not>>)
+                {
+                    const auto choice = Emit(Opcode::Choice);
+                    EmitExpression(expression->child);
+                    Emit(Opcode::FailTwice);
+                    Patch(choice, Here());
+                }
+                else if constexpr (std::is_same_v<T, Box<ast::Alternative>>)
+                {
+                    if (expression->children.empty())
+                    {
+                        throw std::runtime_error(
+                            "Expected alternative to contain at least one expression");
+                    }
+                    EmitChoice(expression->children,
+                               [this](const ast::Expression &child)
+                               { EmitExpression(child); });
+                }
+                else if constexpr (std::is_same_v<T, ast::Class>)
+                {
+                    EmitClass(expression);
+                }
+                else if constexpr (std::is_same_v<T, ast::Dot>)
+                {
+                    Emit(Opcode::Any);
+                }
+                else if constexpr (std::is_same_v<T, ast::Literal>)
+                {
+                    EmitLiteral(expression.value);
+                }
+                else if constexpr (std::is_same_v<T, ast::Identifier>)
+                {
+                    calls.emplace_back(Emit(Opcode::Call), expression.value);
+                }
+                else if constexpr (std::is_same_v<T, ast::Range>)
+                {
+                    EmitSet(ToCharSet(expression));
+                }
+                else
+                {
+                    static_assert(AlwaysFalse<T>, "Did not visit all possible cases");
+                }
+            },
+            expression);
+    }
+
+    void EmitClass(const ast::Class &cls)
+    {
+        if (const auto set = ToCharSet(cls))
+        {
+            EmitSet(*set);
+            return;
+        }
+
+        // Multi-byte members keep the ordered choice of literals then ranges.
+        std::vector<ast::Expression> members;
+        for (const auto &literal : cls.literals)
+        {
+            members.emplace_back(literal);
+        }
+        for (const auto &range : cls.ranges)
+        {
+            members.emplace_back(range);
+        }
+        EmitChoice(members,
+                   [this](const ast::Expression &member) { EmitExpression(member); });
+    }
+
+    void EmitGrammar(const ast::Grammar &grammar)
+    {
+        // Address zero is where a successful top-level rule returns to.
+        Emit(Opcode::End);
+
+        for (const auto &definition : grammar.definitions)
+        {
+            const auto &name = definition.identifier.value;
+            if (program.index.contains(name))
+            {
+                throw std::runtime_error("Tried to compile rule " + name +
+                                         " but it already exists");
+            }
+            program.index[name] = static_cast<std::uint32_t>(program.rules.size());
+            program.rules.push_back(name);
+            program.shapes.push_back(definition.shape);
+        }
+
+        for (const auto &definition : grammar.definitions)
+        {
+            const auto rule = program.index.at(definition.identifier.value);
+            program.addresses.push_back(Here());
+            Emit(Opcode::Open, rule);
+            EmitExpression(definition.expression);
+            Emit(Opcode::Close);
+            Emit(Opcode::Return);
+        }
+
+        for (const auto &[instruction, name] : calls)
+        {
+            if (!program.index.contains(name))
+            {
+                throw std::runtime_error("Tried to call rule " + name +
+                                         " but the grammar doesn't define it");
+            }
+            Patch(instruction, program.addresses[program.index.at(name)]);
+        }
+    }
+
+  private:
+    Program &program;
+    std::vector<std::pair<std::uint32_t, std::string>> calls;
+};
+
+enum class CaptureKind : std::uint8_t
+{
+    Open,
+    Close,
+    Token,
+};
+
+struct Capture
+{
+    CaptureKind kind;
+    std::uint32_t rule;
+    std::size_t start;
+    std::size_t end;
+};
+
+// Call frames share the backtrack stack with choice points and are told apart by
+// their position.
+constexpr std::size_t CallFrame = std::numeric_limits<std::size_t>::max();
+
+struct Entry
+{
+    std::uint32_t address;
+    std::size_t position;
+    std::size_t captures;
+};
+
+// Everything needed to resume a run of the machine.
+struct Machine
+{
+    std::vector<Entry> stack;
+    std::uint32_t pc;
+    std::size_t position;
+    std::vector<Capture> captures;
+};
+
+enum class Status : std::uint8_t
+{
+    Matched,
+    Failed,
+    // Stopped at the end of the available input, which is not the end of the input.
+    Suspended,
+};
+
+// Prepares a machine to run from rule name.
+auto Start(const Program &program, const std::string &name) -> Machine
+{
+    if (!program.index.contains(name))
+    {
+        throw std::runtime_error("Tried to retrieve rule " + name +
+                                 " from program but it doesn't exist");
+    }
+    return Machine{{{0, CallFrame, 0}}, program.addresses[program.index.at(name)], 0, {}};
+}
+
+auto BuildTree(const Program &program,
+               const std::vector<Capture> &captures,
+               std::string_view source) -> Nodes
+{
+    std::vector<Nodes> levels(1);
+    std::vector<const Capture *> opens;
+    for (const auto &capture : captures)
+    {
+        switch (capture.kind)
+        {
+        case CaptureKind::Open:
+            levels.emplace_back();
+            opens.push_back(&capture);
+            break;
+        case CaptureKind::Close:
+        {
+            const Capture &open = *opens.back();
+            Nodes children = std::move(levels.back());
+            levels.pop_back();
+            opens.pop_back();
+            Nodes &parent = levels.back();
+            const ast::Shape shape = program.shapes[open.rule];
+            if (shape == ast::Shape::Inline ||
+                (shape == ast::Shape::Collapse && children.size() == 1))
+            {
+                parent.insert(parent.end(),
+                              std::make_move_iterator(children.begin()),
+                              std::make_move_iterator(children.end()));
+            }
+            else if (shape == ast::Shape::Token)
+            {
+                const std::size_t length = capture.start - open.start;
+                parent.emplace_back(Terminal{source.substr(open.start, length)});
+            }
+            else if (shape != ast::Shape::Skip)
+            {
+                std::pmr::string name{program.rules[open.rule]};
+                parent.emplace_back(NonTerminal{std::move(name), std::move(children)});
+            }
+            break;
+        }
+        case CaptureKind::Token:
+            levels.back().emplace_back(
+                Terminal{source.substr(capture.start, capture.end - capture.start)});
+            break;
+        }
+    }
+    return std::move(levels.front());
+}
+
+auto BuildTape(const Program &program,
+               const std::vector<Capture> &captures,
+               std::string_view source,
+               std::size_t position) -> Tape
+{
+    Tape tape{source, program.rules, program.shapes};
+    tape.position = position;
+    tape.entries.reserve(captures.size() / 2 + 1);
+    std::vector<std::size_t> open;
+    for (const auto &capture : captures)
+    {
+        switch (capture.kind)
+        {
+        case CaptureKind::Open:
+            open.push_back(tape.entries.size());
+            tape.entries.push_back({capture.rule, 0, capture.start, 0});
+            break;
+        case CaptureKind::Close:
+        {
+            TapeEntry &entry = tape.entries[open.back()];
+            entry.size = tape.entries.size() - open.back();
+            entry.end = capture.start;
+            open.pop_back();
+            break;
+        }
+        case CaptureKind::Token:
+            tape.entries.push_back({Tape::Token, 1, capture.start, capture.end});
+            break;
+        }
+    }
+    return tape;
+}
+
+// Runs the machine over source until it matches or fails. Unless complete is set,
+// source is only the input received so far: the machine then suspends where it
+// would need to look past its end, and can be resumed once more input is appended.
+// On success the captures of the match are left in the machine.
+auto Run(const Program &program, Machine &machine, std::string_view source, bool complete)
+    -> Status
+{
+    const auto &code = program.code;
+    const auto &literals = program.literals;
+    const auto &sets = program.sets;
+    auto &stack = machine.stack;
+    auto &captures = machine.captures;
+    std::uint32_t pc = machine.pc;
+    std::size_t position = machine.position;
+    const auto suspend = [&machine, &pc, &position]
+    {
+        machine.pc = pc;
+        machine.position = position;
+        return Status::Suspended;
+    };
+
+    while (true)
+    {
+        const Instruction &instruction = code[pc];
+        bool matched = true;
+        switch (instruction.opcode)
+        {
+        case Opcode::Char:
+            matched = position < source.size() &&
+                      static_cast<unsigned char>(source[position]) == instruction.argument;
+            if (matched)
+            {
+                captures.push_back({CaptureKind::Token, 0, position, position + 1});
+                position++;
+                pc++;
+            }
+            else if (!complete && position == source.size())
+            {
+                return suspend();
+            }
+            break;
+        case Opcode::Literal:
+        {
+            const std::string &literal = literals[instruction.argument];
+            const std::string_view input = source.substr(position);
+            matched = input.starts_with(literal);
+            if (matched)
+            {
+                captures.push_back(
+                    {CaptureKind::Token, 0, position, position + literal.size()});
+                position += literal.size();
+                pc++;
+            }
+            else if (!complete && std::string_view{literal}.starts_with(input))
+            {
+                return suspend();
+            }
+            break;
+        }
+        case Opcode::Set:
+            matched = position < source.size() &&
+                      sets[instruction.argument].Contains(source[position]);
+            if (matched)
+            {
+                captures.push_back({CaptureKind::Token, 0, position, position + 1});
+                position++;
+                pc++;
+            }
+            else if (!complete && position == source.size())
+            {
+                return suspend();
+            }
+            break;
+        case Opcode::Span:
+        {
+            const std::size_t length = sets[instruction.argument].Span(source, position);
+            for (std::size_t i = 0; i < length; i++, position++)
+            {
+                captures.push_back({CaptureKind::Token, 0, position, position + 1});
+            }
+            if (!complete && position == source.size())
+            {
+                // The run may continue in the next input, so it resumes from here.
+                return suspend();
+            }
+            pc++;
+            break;
+        }
+        case Opcode::Any:
+            matched = position < source.size();
+            if (matched)
+            {
+                captures.push_back({CaptureKind::Token, 0, position, position + 1});
+                position++;
+                pc++;
+            }
+            else if (!complete)
+            {
+                return suspend();
+            }
+            break;
+        case Opcode::Choice:
+            stack.push_back({instruction.argument, position, captures.size()});
+            pc++;
+            break;
+        case Opcode::Commit:
+            stack.pop_back();
+            pc = instruction.argument;
+            break;
+        case Opcode::PartialCommit:
+            stack.back().position = position;
+            stack.back().captures = captures.size();
+            pc = instruction.argument;
+            break;
+        case Opcode::BackCommit:
+            position = stack.back().position;
+            captures.resize(stack.back().captures);
+            stack.pop_back();
+            pc = instruction.argument;
+            break;
+        case Opcode::FailTwice:
+            stack.pop_back();
+            matched = false;
+            break;
+        case Opcode::Fail:
+            matched = false;
+            break;
+        case Opcode::Call:
+            stack.push_back({pc + 1, CallFrame, 0});
+            pc = instruction.argument;
+            break;
+        case Opcode::Return:
+            pc = stack.back().address;
+            stack.pop_back();
+            break;
+        case Opcode::Open:
+            captures.push_back({CaptureKind::Open, instruction.argument, position, 0});
+            pc++;
+            break;
+        case Opcode::Close:
+            captures.push_back({CaptureKind::Close, 0, position, position});
+            pc++;
+            break;
+        case Opcode::End:
+            machine.pc = pc;
+            machine.position = position;
+            return Status::Matched;
+        }
+
+        if (!matched)
+        {
+            while (!stack.empty() && stack.back().position == CallFrame)
+            {
+                stack.pop_back();
+            }
+            if (stack.empty())
+            {
+                return Status::Failed;
+            }
+            pc = stack.back().address;
+            position = stack.back().position;
+            captures.resize(stack.back().captures);
+            stack.pop_back();
+        }
+    }
+}
+
+// Turns captures into Visitor events, applying rule shapes the way BuildTree does.
+// Captures may arrive over several calls, but rules shaped by what they contain
+// (Token and Collapse) must arrive whole.
+class Emitter
+{
+  public:
+    Emitter(const Program &program, Visitor &visitor)
+        : program{&program}, visitor{&visitor}
+    {
+    }
+
+    // Delivers captures whose positions are relative to input, which starts at
+    // offset of the whole input.
+    void Deliver(std::span<const Capture> captures,
+                 std::string_view input,
+                 std::size_t offset)
+    {
+        buffer = input;
+        base = offset;
+        for (const auto &capture : captures)
+        {
+            switch (capture.kind)
+            {
+            case CaptureKind::Open:
+                Open(capture.rule, base + capture.start);
+                break;
+            case CaptureKind::Close:
+                Close(base + capture.start);
+                break;
+            case CaptureKind::Token:
+                if (muted == 0)
+                {
+                    const std::size_t start = base + capture.start;
+                    Send({Event::Kind::Token, {}, start, base + capture.end});
+                }
+                break;
+            }
+        }
+    }
+
+  private:
+    struct Frame
+    {
+        std::uint32_t rule;
+        std::size_t start;
+        ast::Shape shape;
+        // For Collapse frames, the events of their contents and how many nodes those
+        // form at the top level.
+        std::vector<Event> held;
+        std::size_t children = 0;
+        std::size_t depth = 0;
+    };
+
+    void Open(std::uint32_t rule, std::size_t start)
+    {
+        const ast::Shape shape = muted != 0 ? ast::Shape::Skip : program->shapes[rule];
+        if (shape == ast::Shape::Skip || shape == ast::Shape::Token)
+        {
+            muted++;
+        }
+        if (shape == ast::Shape::Node)
+        {
+            Send({Event::Kind::Enter, program->rules[rule], start, start});
+        }
+        frames.push_back({rule, start, shape, {}});
+    }
+
+    void Close(std::size_t end)
+    {
+        Frame frame = std::move(frames.back());
+        frames.pop_back();
+        const std::string_view rule = program->rules[frame.rule];
+        switch (frame.shape)
+        {
+        case ast::Shape::Node:
+            Send({Event::Kind::Exit, rule, frame.start, end});
+            break;
+        case ast::Shape::Skip:
+            muted--;
+            break;
+        case ast::Shape::Inline:
+            break;
+        case ast::Shape::Collapse:
+            if (frame.children != 1)
+            {
+                Send({Event::Kind::Enter, rule, frame.start, frame.start});
+            }
+            for (const auto &event : frame.held)
+            {
+                Send(event);
+            }
+            if (frame.children != 1)
+            {
+                Send({Event::Kind::Exit, rule, frame.start, end});
+            }
+            break;
+        case ast::Shape::Token:
+            muted--;
+            Send({Event::Kind::Token, {}, frame.start, end});
+            break;
+        }
+    }
+
+    void Send(const Event &event)
+    {
+        for (auto frame = frames.rbegin(); frame != frames.rend(); ++frame)
+        {
+            if (frame->shape != ast::Shape::Collapse)
+            {
+                continue;
+            }
+            if (frame->depth == 0 && event.kind != Event::Kind::Exit)
+            {
+                frame->children++;
+            }
+            if (event.kind == Event::Kind::Enter)
+            {
+                frame->depth++;
+            }
+            else if (event.kind == Event::Kind::Exit)
+            {
+                frame->depth--;
+            }
+            frame->held.push_back(event);
+            return;
+        }
+        switch (event.kind)
+        {
+        case Event::Kind::Enter:
+            visitor->OnEnter(event.rule, event.start);
+            break;
+        case Event::Kind::Exit:
+            visitor->OnExit(event.rule, event.start, event.end);
+            break;
+        case Event::Kind::Token:
+            visitor->OnToken(buffer.substr(event.start - base, event.end - event.start));
+            break;
+        }
+    }
+
+    const Program *program;
+    Visitor *visitor;
+    std::vector<Frame> frames;
+    // Number of open frames whose contents are not reported.
+    std::size_t muted = 0;
+    std::string_view buffer;
+    std::size_t base = 0;
+};
+
+} // namespace
+
+auto Program::Parse(const std::string &name, std::string_view source) const -> Result
+{
+    Machine machine = Start(*this, name);
+    if (Run(*this, machine, source, true) == Status::Failed)
+    {
+        return Result{Failure{name}};
+    }
+    return Result{Success{BuildTree(*this, machine.captures, source), machine.position}};
+}
+
+auto Program::ParseTape(const std::string &name, std::string_view source) const
+    -> std::optional<Tape>
+{
+    Machine machine = Start(*this, name);
+    if (Run(*this, machine, source, true) == Status::Failed)
+    {
+        return std::nullopt;
+    }
+    return BuildTape(*this, machine.captures, source, machine.position);
+}
+
+struct Stream::State
+{
+    State(const Program &program, const std::string &name, Visitor &visitor)
+        : program{program}, machine{Start(program, name)}, emitter{program, visitor}
+    {
+    }
+
+    // Delivers the captures no choice point can take back anymore.
+    void Flush()
+    {
+        auto &captures = machine.captures;
+        std::size_t limit = captures.size();
+        for (const auto &entry : machine.stack)
+        {
+            if (entry.position != CallFrame)
+            {
+                limit = std::min(limit, entry.captures);
+            }
+        }
+
+        // Rules shaped by what they contain are held back until they are complete.
+        std::vector<std::size_t> opens;
+        for (std::size_t i = 0; i < limit; i++)
+        {
+            if (captures[i].kind == CaptureKind::Open)
+            {
+                opens.push_back(i);
+            }
+            else if (captures[i].kind == CaptureKind::Close && !opens.empty())
+            {
+                opens.pop_back();
+            }
+        }
+        for (const std::size_t open : opens)
+        {
+            const ast::Shape shape = program.shapes[captures[open].rule];
+            if (shape == ast::Shape::Token || shape == ast::Shape::Collapse)
+            {
+                limit = open;
+                break;
+            }
+        }
+
+        emitter.Deliver(std::span{captures}.first(limit), buffer, base);
+        captures.erase(captures.begin(),
+                       captures.begin() + static_cast<std::ptrdiff_t>(limit));
+        for (auto &entry : machine.stack)
+        {
+            if (entry.position != CallFrame)
+            {
+                entry.captures -= limit;
+            }
+        }
+    }
+
+    // Drops the input no choice point or held capture can reach anymore.
+    void Trim()
+    {
+        std::size_t keep = machine.position;
+        for (const auto &entry : machine.stack)
+        {
+            if (entry.position != CallFrame)
+            {
+                keep = std::min(keep, entry.position);
+            }
+        }
+        if (!machine.captures.empty())
+        {
+            keep = std::min(keep, machine.captures.front().start);
+        }
+
+        buffer.erase(0, keep);
+        base += keep;
+        machine.position -= keep;
+        for (auto &entry : machine.stack)
+        {
+            if (entry.position != CallFrame)
+            {
+                entry.position -= keep;
+            }
+        }
+        for (auto &capture : machine.captures)
+        {
+            capture.start -= keep;
+            if (capture.kind != CaptureKind::Open)
+            {
+                capture.end -= keep;
+            }
+        }
+    }
+
+    const Program &program;
+    Machine machine;
+    Emitter emitter;
+    Status status = Status::Suspended;
+    bool finished = false;
+    std::string buffer;
+    // Offset of the first buffered byte in the input.
+    std::size_t base = 0;
+};
+
+Stream::Stream(const Program &program, const std::string &name, Visitor &visitor)
+    : state{std::make_unique<State>(program, name, visitor)}
+{
+}
+
+Stream::Stream(Stream &&) noexcept = default;
+auto Stream::operator=(Stream &&) noexcept -> Stream & = default;
+Stream::~Stream() = default;
+
+void Stream::Feed(std::string_view bytes)
+{
+    if (state->finished)
+    {
+        throw std::runtime_error("Tried to feed input to a stream but it is finished");
+    }
+    // Once the parse is decided, the rest of the input cannot change it.
+    if (state->status != Status::Suspended)
+    {
+        return;
+    }
+    state->buffer.append(bytes);
+    state->status = Run(state->program, state->machine, state->buffer, false);
+    if (state->status != Status::Failed)
+    {
+        state->Flush();
+        state->Trim();
+    }
+}
+
+auto Stream::Finish() -> std::optional<std::size_t>
+{
+    if (!state->finished)
+    {
+        state->finished = true;
+        if (state->status == Status::Suspended)
+        {
+            state->status = Run(state->program, state->machine, state->buffer, true);
+        }
+        if (state->status == Status::Matched)
+        {
+            state->Flush();
+        }
+    }
+    if (state->status != Status::Matched)
+    {
+        return std::nullopt;
+    }
+    return state->base + state->machine.position;
+}
+
+auto Stream::Buffered() const -> std::size_t { return state->buffer.size(); }
+
+auto Compile(const ast::Grammar &grammar) -> Program
+{
+    Program program;
+    Compiler compiler{program};
+    compiler.EmitGrammar(grammar);
+    return program;
+}
+
+} // namespace vm
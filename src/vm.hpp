@@ -0,0 +1,99 @@
+#pragma once
+
+#include "ast.hpp"
+#include "charset.hpp"
+#include "parser.hpp"
+#include "tape.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+// A second backend that compiles an ast::Grammar into a flat instruction stream run
+// by a single dispatch loop with an explicit backtrack stack, in the style of LPeg's
+// parsing machine. Trees are identical to those produced by Generate().
+namespace vm
+{
+
+enum class Opcode : std::uint8_t
+{
+    Char,          // Match the byte in argument and capture it
+    Literal,       // Match literals[argument] and capture it
+    Set,           // Match a byte in sets[argument] and capture it
+    Span,          // Match a run of bytes in sets[argument] and capture each one
+    Any,           // Match any byte and capture it
+    Choice,        // Push a backtrack entry resuming at argument
+    Commit,        // Pop the top backtrack entry and jump to argument
+    PartialCommit, // Move the top backtrack entry to the current state and jump
+    BackCommit,    // Pop the top backtrack entry, restore its state and jump
+    FailTwice,     // Pop the top backtrack entry and fail
+    Fail,          // Backtrack to the most recent choice
+    Call,          // Push a return address and jump to argument
+    Return,        // Pop a return address and jump to it
+    Open,          // Begin a node for rules[argument]
+    Close,         // End the innermost open node
+    End,           // Stop and report success
+};
+
+struct Instruction
+{
+    Opcode opcode;
+    std::uint32_t argument;
+};
+
+struct Program
+{
+    std::vector<Instruction> code;
+    std::vector<std::string> literals;
+    std::vector<CharSet> sets;
+
+    // Rule names, shapes and the address of each rule's first instruction.
+    std::vector<std::string> rules;
+    std::vector<ast::Shape> shapes;
+    std::vector<std::uint32_t> addresses;
+    std::map<std::string, std::uint32_t> index;
+
+    [[nodiscard]] auto Parse(const std::string &name, std::string_view source) const
+        -> Result;
+
+    // Like Parse but returns the match as a flat Tape, which references rules, shapes
+    // and source. Returns nothing if the rule does not match. Tapes hold an entry for
+    // every rule match whatever the rule's shape; Tape::ToNodes() applies the shapes.
+    [[nodiscard]] auto ParseTape(const std::string &name, std::string_view source) const
+        -> std::optional<Tape>;
+};
+
+auto Compile(const ast::Grammar &grammar) -> Program;
+
+// Parses input that arrives in chunks, reporting matches to a Visitor as they are
+// committed. The parse suspends whenever it needs input that has not arrived yet and
+// resumes on the next Feed(). Only the bytes that the parse may still backtrack into,
+// or that a rule delivered as a whole still spans, are kept between chunks. Events
+// report offsets into the whole input.
+class Stream
+{
+  public:
+    // The program and visitor must outlive the stream.
+    Stream(const Program &program, const std::string &name, Visitor &visitor);
+    Stream(const Stream &) = delete;
+    Stream(Stream &&) noexcept;
+    auto operator=(const Stream &) -> Stream & = delete;
+    auto operator=(Stream &&) noexcept -> Stream &;
+    ~Stream();
+
+    // Appends bytes to the input and parses as far as they allow.
+    void Feed(std::string_view bytes);
+
+    // Marks the end of the input and completes the parse. Returns the end of the
+    // match, or nothing if the rule does not match.
+    auto Finish() -> std::optional<std::size_t>;
+
+    // Number of input bytes currently held.
+    [[nodiscard]] auto Buffered() const -> std::size_t;
+
+  private:
+    struct State;
+    std::unique_ptr<State> state;
+};
+
+} // namespace vm
@@ -0,0 +1,65 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "analysis.hpp"
+#include "grammar.hpp"
+
+TEST_CASE("Compute FIRST sets", "[Analysis]")
+{
+    SECTION("Terminals and sequences")
+    {
+        const auto grammar = ast::Grammar(
+            ast::Definition(ast::Identifier("A"),
+                            ast::Sequence(ast::Optional(ast::Literal("x")),
+                                          ast::Class({ast::Range("0", "9")}, {}))),
+            ast::Definition(ast::Identifier("B"),
+                            ast::Sequence(ast::Not(ast::Literal("x")), ast::Dot())),
+            ast::Definition(ast::Identifier("C"), ast::ZeroOrMore(ast::Literal("c"))));
+        const analysis::FirstSets firsts{grammar};
+
+        const auto a = firsts.OfRule("A");
+        REQUIRE(!a.nullable);
+        REQUIRE(a.set.Contains('x'));
+        REQUIRE(a.set.Contains('7'));
+        REQUIRE(!a.set.Contains('y'));
+
+        const auto b = firsts.OfRule("B");
+        REQUIRE(!b.nullable);
+        REQUIRE(b.set.Contains('y'));
+
+        const auto c = firsts.OfRule("C");
+        REQUIRE(c.nullable);
+        REQUIRE(c.set.Contains('c'));
+        REQUIRE(!c.set.Contains('d'));
+
+        REQUIRE_THROWS(firsts.OfRule("D"));
+    }
+    SECTION("Recursive rules reach a fixpoint")
+    {
+        const auto grammar = ast::Grammar(
+            ast::Definition(ast::Identifier("List"),
+                            ast::Alternative(ast::Sequence(ast::Literal("("),
+                                                           ast::Identifier("List"),
+                                                           ast::Literal(")")),
+                                             ast::Identifier("Atom"))),
+            ast::Definition(ast::Identifier("Atom"), ast::Literal("a")));
+        const auto list = analysis::FirstSets{grammar}.OfRule("List");
+        REQUIRE(!list.nullable);
+        REQUIRE(list.set.Contains('('));
+        REQUIRE(list.set.Contains('a'));
+        REQUIRE(!list.set.Contains(')'));
+    }
+    SECTION("PEG grammar rules")
+    {
+        const analysis::FirstSets firsts{GetPegGrammarAST()};
+        REQUIRE(firsts.OfRule("Spacing").nullable);
+
+        const auto primary = firsts.OfRule("Primary");
+        REQUIRE(!primary.nullable);
+        for (const char c : std::string("aZ_('\"[."))
+        {
+            REQUIRE(primary.set.Contains(c));
+        }
+        REQUIRE(!primary.set.Contains('0'));
+        REQUIRE(!primary.set.Contains(')'));
+    }
+}
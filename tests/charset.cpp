@@ -0,0 +1,61 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "charset.hpp"
+
+#include <string>
+
+TEST_CASE("Character sets", "[CharSet]")
+{
+    SECTION("Test membership")
+    {
+        CharSet set;
+        set.Insert('a', 'c');
+        set.Insert('_');
+        REQUIRE(set.Contains('a'));
+        REQUIRE(set.Contains('c'));
+        REQUIRE(set.Contains('_'));
+        REQUIRE(!set.Contains('d'));
+        REQUIRE(!set.Contains('\0'));
+    }
+    SECTION("Convert classes")
+    {
+        const auto set =
+            ToCharSet(ast::Class({ast::Range("0", "9")}, {ast::Literal("x")}));
+        REQUIRE(set.has_value());
+        REQUIRE(set->Contains('5'));
+        REQUIRE(set->Contains('x'));
+        REQUIRE(!set->Contains('a'));
+        REQUIRE(!ToCharSet(ast::Class({}, {ast::Literal("ab")})).has_value());
+    }
+    SECTION("Scan runs of members")
+    {
+        // Few ranges take the vectorized path, many ranges the table lookup.
+        CharSet few;
+        few.Insert('a', 'z');
+        few.Insert('0', '9');
+        CharSet many;
+        for (const char c : std::string("acegikmoqsuwy02468"))
+        {
+            many.Insert(c);
+        }
+
+        for (const std::size_t length : {0, 1, 15, 16, 17, 40, 100})
+        {
+            const std::string run(length, 'a');
+            REQUIRE(few.Span(run + "-" + run, 0) == length);
+            REQUIRE(few.Span("-" + run, 1) == length);
+            REQUIRE(many.Span(run + "b", 0) == length);
+        }
+        REQUIRE(few.Span("abc123XYZ", 0) == 6);
+        REQUIRE(few.Span("", 0) == 0);
+    }
+    SECTION("Handle bytes outside ASCII")
+    {
+        CharSet set;
+        set.Insert(static_cast<char>(0x80), static_cast<char>(0xFF));
+        const std::string input(20, static_cast<char>(0xC3));
+        REQUIRE(set.Contains(static_cast<char>(0x80)));
+        REQUIRE(!set.Contains('a'));
+        REQUIRE(set.Span(input + "a", 0) == 20);
+    }
+}
@@ -0,0 +1,104 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "helpers.hpp"
+
+#include "codegen.hpp"
+#include "generator.hpp"
+#include "reader.hpp"
+
+#include <arithmetic.hpp>
+#include <escapes.hpp>
+
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+
+auto Same(const Node &expected, const arithmetic::Node &actual) -> bool
+{
+    if (std::holds_alternative<Terminal>(expected))
+    {
+        return actual.type.empty() && actual.value == std::get<Terminal>(expected).value;
+    }
+    const auto &node = std::get<NonTerminal>(expected);
+    if (node.type != actual.type || node.children.size() != actual.children.size())
+    {
+        return false;
+    }
+    for (std::size_t i = 0; i < node.children.size(); i++)
+    {
+        if (!Same(node.children[i], actual.children[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("Generated parsers", "[Codegen]")
+{
+    std::ifstream file{ARITHMETIC_GRAMMAR};
+    std::stringstream text;
+    text << file.rdbuf();
+    const auto grammar = ReadGrammar(text.str());
+    const auto collection = Generate(grammar);
+
+    SECTION("Match the closure backend")
+    {
+        for (const std::string input : {"1", " 12 + 3*4", "(1+2) * (3 - 4) / 5\n"})
+        {
+            const auto expected = UnwrapSuccess(collection.Parse("Expression", input));
+            const auto actual = arithmetic::ParseExpression(input);
+            REQUIRE(actual.has_value());
+            REQUIRE(actual->position == expected.position);
+            REQUIRE(actual->nodes.size() == 1);
+            REQUIRE(Same(expected.node[0], actual->nodes[0]));
+        }
+    }
+    SECTION("Reject invalid input")
+    {
+        for (const std::string input : {"", "1 +", "(1", "1 2"})
+        {
+            REQUIRE_NOTHROW(UnwrapFailure(collection.Parse("Expression", input)));
+            REQUIRE(!arithmetic::ParseExpression(input).has_value());
+        }
+    }
+    SECTION("Expose every rule")
+    {
+        const auto number = arithmetic::ParseNumber("42 ");
+        REQUIRE(number.has_value());
+        REQUIRE(number->position == 3);
+        REQUIRE(number->nodes[0].value == "42 ");
+    }
+    SECTION("Shape rules like the closure backend")
+    {
+        const auto ast = ast::Grammar(
+            ast::Definition(ast::Identifier("Word"),
+                            ast::OneOrMore(ast::Range("a", "z")),
+                            ast::Shape::Token),
+            ast::Definition(ast::Identifier("Spacing"),
+                            ast::ZeroOrMore(ast::Literal(" ")),
+                            ast::Shape::Skip));
+        const auto header = codegen::Emit(ast, "shaped");
+        REQUIRE(header.find("return ok && Capture(state, start, mark);") !=
+                std::string::npos);
+        REQUIRE(header.find("if (ok) state.nodes.resize(mark);") != std::string::npos);
+    }
+    SECTION("Escaped bytes followed by digits")
+    {
+        // Longer than the literals compared byte by byte, so emitted as strings.
+        REQUIRE(escapes::ParseTab("abcdefghi\t1").has_value());
+        REQUIRE(!escapes::ParseTab("abcdefghiI").has_value());
+        REQUIRE(escapes::ParseQuote("abcdefghi\"2").has_value());
+        REQUIRE(!escapes::ParseQuote("abcdefghi\"").has_value());
+    }
+    SECTION("Undefined rules are reported at generation time")
+    {
+        const auto ast = ast::Grammar(
+            ast::Definition(ast::Identifier("Start"), ast::Identifier("Missing")));
+        REQUIRE_THROWS(codegen::Emit(ast, "missing"));
+    }
+}
@@ -11,40 +11,45 @@ TEST_CASE("Literals are parsed", "[Literal]")
     SECTION("Handle single values")
     {
         {
-            auto res = UnwrapSuccess(Literal("a")("a"));
+            auto res = UnwrapSuccess(Parse(Literal("a"), "a"));
             REQUIRE(!res.node.empty());
-            REQUIRE(res.remainder.empty());
+            REQUIRE(res.position == 1);
             REQUIRE(UnwrapTerminal(res.node[0]).value == "a");
         }
         {
-            auto res = UnwrapSuccess(Literal("0")("0123"));
+            auto res = UnwrapSuccess(Parse(Literal("0"), "0123"));
             REQUIRE(!res.node.empty());
-            REQUIRE(res.remainder.size() == 3);
-            REQUIRE(res.remainder == "123");
+            REQUIRE(res.position == 1);
             REQUIRE(UnwrapTerminal(res.node[0]).value == "0");
         }
     }
     SECTION("Handle multiple values")
     {
         {
-            auto res = UnwrapSuccess(Literal("ABC")("ABC"));
+            auto res = UnwrapSuccess(Parse(Literal("ABC"), "ABC"));
             REQUIRE(!res.node.empty());
-            REQUIRE(res.remainder.empty());
+            REQUIRE(res.position == 3);
             REQUIRE(UnwrapTerminal(res.node[0]).value == "ABC");
         }
         {
-            auto res = UnwrapSuccess(Literal("123")("123456"));
+            auto res = UnwrapSuccess(Parse(Literal("123"), "123456"));
             REQUIRE(!res.node.empty());
-            REQUIRE(res.remainder.size() == 3);
-            REQUIRE(res.remainder == "456");
+            REQUIRE(res.position == 3);
             REQUIRE(UnwrapTerminal(res.node[0]).value == "123");
         }
     }
     SECTION("Expect failure")
     {
-        REQUIRE_NOTHROW(UnwrapFailure(Literal("X")("Y")));
-        REQUIRE_NOTHROW(UnwrapFailure(Literal("XY")("YX")));
-        REQUIRE_NOTHROW(UnwrapFailure(Literal("A")("")));
+        REQUIRE_NOTHROW(UnwrapFailure(Parse(Literal("X"), "Y")));
+        REQUIRE_NOTHROW(UnwrapFailure(Parse(Literal("XY"), "YX")));
+        REQUIRE_NOTHROW(UnwrapFailure(Parse(Literal("A"), "")));
+    }
+    SECTION("Reference the input instead of copying it")
+    {
+        const std::string input = "XYZ";
+        auto res = UnwrapSuccess(Parse(Sequence({Literal("X"), Literal("YZ")}), input));
+        REQUIRE(res.position == 3);
+        REQUIRE(UnwrapTerminal(res.node[1]).value.data() == input.data() + 1);
     }
 }
 
@@ -53,32 +58,60 @@ TEST_CASE("Ranges are parsed", "[Range]")
     SECTION("Handle range values")
     {
         {
-            auto res = UnwrapSuccess(Range("0", "9")("0"));
+            auto res = UnwrapSuccess(Parse(Range("0", "9"), "0"));
             REQUIRE(!res.node.empty());
-            REQUIRE(res.remainder.empty());
+            REQUIRE(res.position == 1);
             REQUIRE(UnwrapTerminal(res.node[0]).value == "0");
         }
         {
-            auto res = UnwrapSuccess(Range("0", "9")("9"));
+            auto res = UnwrapSuccess(Parse(Range("0", "9"), "9"));
             REQUIRE(!res.node.empty());
-            REQUIRE(res.remainder.empty());
+            REQUIRE(res.position == 1);
             REQUIRE(UnwrapTerminal(res.node[0]).value == "9");
         }
         {
-            auto res = UnwrapSuccess(Range("a", "z")("f"));
+            auto res = UnwrapSuccess(Parse(Range("a", "z"), "f"));
             REQUIRE(!res.node.empty());
-            REQUIRE(res.remainder.empty());
+            REQUIRE(res.position == 1);
             REQUIRE(UnwrapTerminal(res.node[0]).value == "f");
         }
         {
-            auto res = UnwrapSuccess(Range("0", "9")("5678"));
+            auto res = UnwrapSuccess(Parse(Range("0", "9"), "5678"));
             REQUIRE(!res.node.empty());
-            REQUIRE(res.remainder.size() == 3);
-            REQUIRE(res.remainder == "678");
+            REQUIRE(res.position == 1);
             REQUIRE(UnwrapTerminal(res.node[0]).value == "5");
         }
     }
-    SECTION("Expect failure") { REQUIRE_NOTHROW(UnwrapFailure(Range("0", "1")("2"))); }
+    SECTION("Expect failure")
+    {
+        REQUIRE_NOTHROW(UnwrapFailure(Parse(Range("0", "1"), "2")));
+    }
+}
+
+TEST_CASE("Classes are parsed", "[Class]")
+{
+    CharSet digits;
+    digits.Insert('0', '9');
+
+    SECTION("Handle single bytes")
+    {
+        auto res = UnwrapSuccess(Parse(Class(digits), "42"));
+        REQUIRE(res.node.size() == 1);
+        REQUIRE(res.position == 1);
+        REQUIRE(UnwrapTerminal(res.node[0]).value == "4");
+        REQUIRE_NOTHROW(UnwrapFailure(Parse(Class(digits), "a")));
+        REQUIRE_NOTHROW(UnwrapFailure(Parse(Class(digits), "")));
+    }
+    SECTION("Handle runs like repeated classes")
+    {
+        const std::string input = "12345678901234567890x";
+        auto res = UnwrapSuccess(Parse(Run(digits, 1), input));
+        REQUIRE(res.position == 20);
+        REQUIRE(res.node == UnwrapSuccess(Parse(OneOrMore(Class(digits)), input)).node);
+
+        REQUIRE(UnwrapSuccess(Parse(Run(digits, 0), "x")).position == 0);
+        REQUIRE_NOTHROW(UnwrapFailure(Parse(Run(digits, 1), "x")));
+    }
 }
 
 TEST_CASE("Dot is parsed", "[Dot]")
@@ -86,9 +119,9 @@ TEST_CASE("Dot is parsed", "[Dot]")
     SECTION("Handle single values")
     {
         {
-            auto res = UnwrapSuccess(Dot()("a"));
+            auto res = UnwrapSuccess(Parse(Dot(), "a"));
             REQUIRE(!res.node.empty());
-            REQUIRE(res.remainder.empty());
+            REQUIRE(res.position == 1);
             REQUIRE(UnwrapTerminal(res.node[0]).value == "a");
         }
     }
@@ -100,10 +133,10 @@ TEST_CASE("Sequence parsers", "[Sequence]")
     {
         {
             auto res = UnwrapSuccess(
-                Sequence({Literal("A"), Literal("B"), Literal("C")})("ABC"));
+                Parse(Sequence({Literal("A"), Literal("B"), Literal("C")}), "ABC"));
             REQUIRE(!res.node.empty());
             REQUIRE(res.node.size() == 3);
-            REQUIRE(res.remainder.empty());
+            REQUIRE(res.position == 3);
             REQUIRE(UnwrapTerminal(res.node[0]).value == "A");
             REQUIRE(UnwrapTerminal(res.node[1]).value == "B");
             REQUIRE(UnwrapTerminal(res.node[2]).value == "C");
@@ -111,8 +144,17 @@ TEST_CASE("Sequence parsers", "[Sequence]")
     }
     SECTION("Expect failure")
     {
-        REQUIRE_NOTHROW(
-            UnwrapFailure(Sequence({Literal("0"), Literal("1"), Literal("2")})("092")));
+        REQUIRE_NOTHROW(UnwrapFailure(
+            Parse(Sequence({Literal("0"), Literal("1"), Literal("2")}), "092")));
+    }
+    SECTION("Drop the nodes of a partial match")
+    {
+        const auto parser = Alternative({Sequence({Literal("a"), Literal("b")}),
+                                         Sequence({Literal("a"), Literal("c")})});
+        auto res = UnwrapSuccess(Parse(parser, "ac"));
+        REQUIRE(res.node.size() == 2);
+        REQUIRE(UnwrapTerminal(res.node[0]).value == "a");
+        REQUIRE(UnwrapTerminal(res.node[1]).value == "c");
     }
 }
 
@@ -122,25 +164,106 @@ TEST_CASE("Alternative parsers", "[Alternative]")
     {
         {
             auto res = UnwrapSuccess(
-                Alternative({Literal("A"), Literal("B"), Literal("C")})("C"));
+                Parse(Alternative({Literal("A"), Literal("B"), Literal("C")}), "C"));
             REQUIRE(!res.node.empty());
             REQUIRE(res.node.size() == 1);
-            REQUIRE(res.remainder.empty());
+            REQUIRE(res.position == 1);
             REQUIRE(UnwrapTerminal(res.node[0]).value == "C");
         }
         {
-            auto res = UnwrapSuccess(Alternative({Literal("2"), Literal("1")})("123"));
+            auto res =
+                UnwrapSuccess(Parse(Alternative({Literal("2"), Literal("1")}), "123"));
             REQUIRE(!res.node.empty());
             REQUIRE(res.node.size() == 1);
-            REQUIRE(res.remainder.size() == 2);
+            REQUIRE(res.position == 1);
             REQUIRE(UnwrapTerminal(res.node[0]).value == "1");
         }
     }
     SECTION("Expect failure")
     {
-        REQUIRE_NOTHROW(UnwrapFailure(Alternative({Literal("0")})("1")));
-        REQUIRE_NOTHROW(
-            UnwrapFailure(Alternative({Literal("0"), Literal("1"), Literal("2")})("3")));
+        REQUIRE_NOTHROW(UnwrapFailure(Parse(Alternative({Literal("0")}), "1")));
+        REQUIRE_NOTHROW(UnwrapFailure(
+            Parse(Alternative({Literal("0"), Literal("1"), Literal("2")}), "3")));
+    }
+}
+
+TEST_CASE("Dispatching alternative parsers", "[Alternative]")
+{
+    // Counts how often the wrapped parser is tried.
+    std::vector<int> calls(3, 0);
+    const auto counted = [&calls](std::size_t index, const Parser &parser) -> Parser
+    {
+        return [&calls, index, parser](Context &context, std::size_t position)
+        {
+            calls[index]++;
+            return parser(context, position);
+        };
+    };
+
+    analysis::First a;
+    a.set.Insert('a');
+    analysis::First ab = a;
+    ab.set.Insert('b');
+    const analysis::First anything{{}, true};
+
+    const auto parser = Alternative({counted(0, Literal("a")),
+                                     counted(1, Sequence({Literal("b"), Literal("c")})),
+                                     counted(2, Optional(Literal("b")))},
+                                    {a, ab, anything});
+
+    SECTION("Skip parsers that cannot match the next byte")
+    {
+        auto res = UnwrapSuccess(Parse(parser, "bd"));
+        REQUIRE(res.position == 1);
+        REQUIRE(calls == std::vector<int>{0, 1, 1});
+    }
+    SECTION("Keep ordered choice")
+    {
+        auto res = UnwrapSuccess(Parse(parser, "bc"));
+        REQUIRE(res.position == 2);
+        REQUIRE(calls == std::vector<int>{0, 1, 0});
+    }
+    SECTION("Only try nullable parsers at the end of input")
+    {
+        auto res = UnwrapSuccess(Parse(parser, ""));
+        REQUIRE(res.position == 0);
+        REQUIRE(calls == std::vector<int>{0, 0, 1});
+    }
+}
+
+TEST_CASE("Keyword parsers", "[Keywords]")
+{
+    SECTION("Match like an ordered choice of literals")
+    {
+        const std::vector<std::string> values{"in", "int", "i", "for", "foreach", ""};
+        std::vector<Parser> literals;
+        for (const auto &value : values)
+        {
+            literals.push_back(Literal(value));
+        }
+        const auto expected = Alternative(literals);
+        const auto actual = Keywords(values);
+        for (const auto *input : {"int", "in", "i", "foreach", "for", "fo", "x", ""})
+        {
+            const auto res = UnwrapSuccess(Parse(actual, input));
+            REQUIRE(res.position == UnwrapSuccess(Parse(expected, input)).position);
+            REQUIRE(res.node == UnwrapSuccess(Parse(expected, input)).node);
+        }
+    }
+    SECTION("Handle many keywords")
+    {
+        std::vector<std::string> values;
+        for (int i = 0; i < 500; i++)
+        {
+            values.push_back("k" + std::to_string(i));
+        }
+        const auto parser = Keywords(values);
+        // Ordered choice: k4 is listed before k499.
+        const auto res = UnwrapSuccess(Parse(parser, "k499"));
+        REQUIRE(res.position == 2);
+        REQUIRE(UnwrapTerminal(res.node[0]).value == "k4");
+        REQUIRE_NOTHROW(UnwrapFailure(Parse(parser, "j1")));
+        REQUIRE_NOTHROW(UnwrapFailure(Parse(parser, "")));
     }
 }
 
@@ -149,17 +272,17 @@ TEST_CASE("Optional parsers", "[Optional]")
     SECTION("Parse optionals")
     {
         {
-            auto res = UnwrapSuccess(Optional(Literal("1"))("1"));
+            auto res = UnwrapSuccess(Parse(Optional(Literal("1")), "1"));
             REQUIRE(!res.node.empty());
             REQUIRE(res.node.size() == 1);
-            REQUIRE(res.remainder.empty());
+            REQUIRE(res.position == 1);
             REQUIRE(UnwrapTerminal(res.node[0]).value == "1");
         }
         {
-            auto res = UnwrapSuccess(Optional(Literal("A"))("C"));
+            auto res = UnwrapSuccess(Parse(Optional(Literal("A")), "C"));
             REQUIRE(res.node.empty());
             REQUIRE(res.node.empty());
-            REQUIRE(res.remainder.size() == 1);
+            REQUIRE(res.position == 0);
         }
     }
 }
@@ -169,17 +292,17 @@ TEST_CASE("One or more parsers", "[OneOrMore]")
     SECTION("Parse one or more literals")
     {
         {
-            auto res = UnwrapSuccess(OneOrMore(Literal("1"))("1"));
+            auto res = UnwrapSuccess(Parse(OneOrMore(Literal("1")), "1"));
             REQUIRE(!res.node.empty());
             REQUIRE(res.node.size() == 1);
-            REQUIRE(res.remainder.empty());
+            REQUIRE(res.position == 1);
             REQUIRE(UnwrapTerminal(res.node[0]).value == "1");
         }
         {
-            auto res = UnwrapSuccess(OneOrMore(Literal("1"))("111"));
+            auto res = UnwrapSuccess(Parse(OneOrMore(Literal("1")), "111"));
             REQUIRE(!res.node.empty());
             REQUIRE(res.node.size() == 3);
-            REQUIRE(res.remainder.empty());
+            REQUIRE(res.position == 3);
             REQUIRE(UnwrapTerminal(res.node[0]).value == "1");
             REQUIRE(UnwrapTerminal(res.node[1]).value == "1");
             REQUIRE(UnwrapTerminal(res.node[2]).value == "1");
@@ -187,8 +310,8 @@ TEST_CASE("One or more parsers", "[OneOrMore]")
     }
     SECTION("Fail to parse a single literal")
     {
-        REQUIRE_NOTHROW(UnwrapFailure(OneOrMore(Literal("1"))("0")));
-        REQUIRE_NOTHROW(UnwrapFailure(OneOrMore(Literal("1"))("321")));
+        REQUIRE_NOTHROW(UnwrapFailure(Parse(OneOrMore(Literal("1")), "0")));
+        REQUIRE_NOTHROW(UnwrapFailure(Parse(OneOrMore(Literal("1")), "321")));
     }
 }
 
@@ -197,35 +320,35 @@ TEST_CASE("Zero or more parsers", "[ZeroOrMore]")
     SECTION("Parse zero or more literals")
     {
         {
-            auto res = UnwrapSuccess(ZeroOrMore(Literal("1"))("1"));
+            auto res = UnwrapSuccess(Parse(ZeroOrMore(Literal("1")), "1"));
             REQUIRE(!res.node.empty());
             REQUIRE(res.node.size() == 1);
-            REQUIRE(res.remainder.empty());
+            REQUIRE(res.position == 1);
             REQUIRE(UnwrapTerminal(res.node[0]).value == "1");
         }
         {
-            auto res = UnwrapSuccess(ZeroOrMore(Literal("1"))("111"));
+            auto res = UnwrapSuccess(Parse(ZeroOrMore(Literal("1")), "111"));
             REQUIRE(!res.node.empty());
             REQUIRE(res.node.size() == 3);
-            REQUIRE(res.remainder.empty());
+            REQUIRE(res.position == 3);
             REQUIRE(UnwrapTerminal(res.node[0]).value == "1");
             REQUIRE(UnwrapTerminal(res.node[1]).value == "1");
             REQUIRE(UnwrapTerminal(res.node[2]).value == "1");
         }
         {
-            auto res = UnwrapSuccess(ZeroOrMore(Literal("1"))("0"));
+            auto res = UnwrapSuccess(Parse(ZeroOrMore(Literal("1")), "0"));
             REQUIRE(res.node.empty());
-            REQUIRE(res.remainder.size() == 1);
+            REQUIRE(res.position == 0);
         }
         {
-            auto res = UnwrapSuccess(ZeroOrMore(Literal("A"))("98765"));
+            auto res = UnwrapSuccess(Parse(ZeroOrMore(Literal("A")), "98765"));
             REQUIRE(res.node.empty());
-            REQUIRE(res.remainder.size() == 5);
+            REQUIRE(res.position == 0);
         }
         {
-            auto res = UnwrapSuccess(ZeroOrMore(Literal("Z"))("ABC"));
+            auto res = UnwrapSuccess(Parse(ZeroOrMore(Literal("Z")), "ABC"));
             REQUIRE(res.node.empty());
-            REQUIRE(res.remainder.size() == 3);
+            REQUIRE(res.position == 0);
         }
     }
 }
@@ -235,9 +358,9 @@ TEST_CASE("And parser", "[And]")
     SECTION("Parse AND literals")
     {
         {
-            auto res = UnwrapSuccess(And(Literal("1"))("1"));
+            auto res = UnwrapSuccess(Parse(And(Literal("1")), "1"));
             REQUIRE(res.node.empty());
-            REQUIRE(res.remainder.size() == 1);
+            REQUIRE(res.position == 0);
         }
     }
 }
@@ -247,14 +370,14 @@ TEST_CASE("Not parser", "[Not]")
     SECTION("Parse NOT literals")
     {
         {
-            auto res = UnwrapSuccess(Not(Literal("1"))("0"));
+            auto res = UnwrapSuccess(Parse(Not(Literal("1")), "0"));
             REQUIRE(res.node.empty());
-            REQUIRE(res.remainder.size() == 1);
+            REQUIRE(res.position == 0);
         }
         {
-            auto res = UnwrapSuccess(Not(Literal("1"))("ABC"));
+            auto res = UnwrapSuccess(Parse(Not(Literal("1")), "ABC"));
             REQUIRE(res.node.empty());
-            REQUIRE(res.remainder.size() == 3);
+            REQUIRE(res.position == 0);
         }
     }
 }
@@ -264,18 +387,19 @@ TEST_CASE("Definition parser", "[Definition]")
     SECTION("Parse definitions")
     {
         {
-            auto res = UnwrapSuccess(Definition(Literal("0"), "Zero")("0"));
+            auto res = UnwrapSuccess(Parse(Definition(Literal("0"), "Zero"), "0"));
             REQUIRE(res.node.size() == 1);
-            REQUIRE(res.remainder.empty());
+            REQUIRE(res.position == 1);
             REQUIRE(UnwrapNonTerminal(res.node[0]).children.size() == 1);
             REQUIRE(UnwrapNonTerminal(res.node[0]).type == "Zero");
             REQUIRE(UnwrapTerminal(UnwrapNonTerminal(res.node[0]).children[0]).value ==
                     "0");
         }
         {
-            auto res = UnwrapSuccess(Definition(ZeroOrMore(Dot()), "All")("123456789"));
+            auto res =
+                UnwrapSuccess(Parse(Definition(ZeroOrMore(Dot()), "All"), "123456789"));
             REQUIRE(res.node.size() == 1);
-            REQUIRE(res.remainder.empty());
+            REQUIRE(res.position == 9);
             REQUIRE(UnwrapNonTerminal(res.node[0]).children.size() == 9);
             REQUIRE(UnwrapNonTerminal(res.node[0]).type == "All");
             REQUIRE(UnwrapTerminal(UnwrapNonTerminal(res.node[0]).children[0]).value ==
@@ -287,9 +411,9 @@ TEST_CASE("Definition parser", "[Definition]")
                            "ZerosAndOnes");
 
             {
-                auto res = UnwrapSuccess(parser("0000011111"));
+                auto res = UnwrapSuccess(Parse(parser, "0000011111"));
 
-                REQUIRE(res.remainder.empty());
+                REQUIRE(res.position == 10);
 
                 REQUIRE(res.node.size() == 1);
                 const auto &root = UnwrapNonTerminal(res.node[0]);
@@ -302,9 +426,9 @@ TEST_CASE("Definition parser", "[Definition]")
                 }
             }
 
-            REQUIRE_NOTHROW(UnwrapFailure(parser("111000")));
-            REQUIRE_NOTHROW(UnwrapFailure(parser("0")));
-            REQUIRE_NOTHROW(UnwrapFailure(parser("")));
+            REQUIRE_NOTHROW(UnwrapFailure(Parse(parser, "111000")));
+            REQUIRE_NOTHROW(UnwrapFailure(Parse(parser, "0")));
+            REQUIRE_NOTHROW(UnwrapFailure(Parse(parser, "")));
         }
     }
 }
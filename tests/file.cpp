@@ -0,0 +1,36 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "file.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+TEST_CASE("Map files into memory", "[File]")
+{
+    SECTION("Map the contents of a file")
+    {
+        std::ifstream input{ARITHMETIC_GRAMMAR};
+        std::stringstream expected;
+        expected << input.rdbuf();
+
+        MappedFile file{ARITHMETIC_GRAMMAR};
+        REQUIRE(file.View() == expected.str());
+
+        // Moving keeps the mapping alive.
+        MappedFile moved{std::move(file)};
+        REQUIRE(moved.View() == expected.str());
+    }
+    SECTION("Map an empty file")
+    {
+        const auto path = std::filesystem::temp_directory_path() / "pegpp-empty-file";
+        std::ofstream{path}.close();
+        const MappedFile file{path.string()};
+        REQUIRE(file.View().empty());
+        std::filesystem::remove(path);
+    }
+    SECTION("Reject files that don't exist")
+    {
+        REQUIRE_THROWS(MappedFile{"/nonexistent/pegpp-file"});
+    }
+}
@@ -5,6 +5,17 @@
 #include "ast.hpp"
 #include "generator.hpp"
 
+#include <any>
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory_resource>
+#include <ranges>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
 TEST_CASE("Generate and use collection", "[Generate]")
 {
     SECTION("Generate empty collection")
@@ -23,18 +34,18 @@ TEST_CASE("Generate and use collection", "[Generate]")
         const auto collection = Generate(ast);
 
         {
-            const auto result = collection.Get("Zero")("0");
-            REQUIRE(UnwrapSuccess(result).remainder.empty());
+            const auto result = collection.Parse("Zero", "0");
+            REQUIRE(UnwrapSuccess(result).position == 1);
             REQUIRE(UnwrapSuccess(result).node.size() == 1);
         }
         {
-            const auto result = collection.Get("One")("1");
-            REQUIRE(UnwrapSuccess(result).remainder.empty());
+            const auto result = collection.Parse("One", "1");
+            REQUIRE(UnwrapSuccess(result).position == 1);
             REQUIRE(UnwrapSuccess(result).node.size() == 1);
         }
         {
-            const auto result = collection.Get("ZeroThenOne")("01");
-            REQUIRE(UnwrapSuccess(result).remainder.empty());
+            const auto result = collection.Parse("ZeroThenOne", "01");
+            REQUIRE(UnwrapSuccess(result).position == 2);
             REQUIRE(UnwrapSuccess(result).node.size() == 1);
 
             const auto root = UnwrapNonTerminal(UnwrapSuccess(result).node[0]);
@@ -44,4 +55,802 @@ TEST_CASE("Generate and use collection", "[Generate]")
             REQUIRE(UnwrapNonTerminal(root.children[1]).type == "One");
         }
     }
+    SECTION("Link recursive rules")
+    {
+        const auto ast = ast::Grammar(
+            ast::Definition(ast::Identifier("Nested"),
+                            ast::Alternative(ast::Sequence(ast::Literal("("),
+                                                           ast::Identifier("Nested"),
+                                                           ast::Literal(")")),
+                                             ast::Identifier("Atom"))),
+            ast::Definition(ast::Identifier("Atom"), ast::Literal("x")));
+        auto generated = Generate(ast);
+        // Linked rules must survive the collection being moved.
+        const auto collection = std::move(generated);
+
+        REQUIRE(UnwrapSuccess(collection.Parse("Nested", "((x))")).position == 5);
+        REQUIRE_NOTHROW(UnwrapFailure(collection.Parse("Nested", "((x)")));
+    }
+    SECTION("Parse deeply nested input")
+    {
+        const auto ast = ast::Grammar(ast::Definition(
+            ast::Identifier("List"),
+            ast::Sequence(ast::Literal("("),
+                          ast::ZeroOrMore(ast::Identifier("List")),
+                          ast::Literal(")"))));
+        const auto collection = Generate(ast);
+        const std::size_t depth = 2000;
+        const std::string input = std::string(depth, '(') + std::string(depth, ')');
+
+        const auto result = UnwrapSuccess(collection.Parse("List", input));
+        REQUIRE(result.position == input.size());
+        const Node *node = &result.node[0];
+        for (std::size_t level = 1; level < depth; level++)
+        {
+            node = &std::get<NonTerminal>(*node).children[1];
+        }
+        REQUIRE(std::get<NonTerminal>(*node).children.size() == 2);
+    }
+    SECTION("Report undefined rules when generating")
+    {
+        const auto ast = ast::Grammar(
+            ast::Definition(ast::Identifier("A"), ast::Identifier("Missing")));
+        REQUIRE_THROWS(Generate(ast));
+    }
+    SECTION("Report duplicate rules when generating")
+    {
+        const auto ast =
+            ast::Grammar(ast::Definition(ast::Identifier("A"), ast::Literal("a")),
+                         ast::Definition(ast::Identifier("A"), ast::Literal("b")));
+        REQUIRE_THROWS(Generate(ast));
+    }
+}
+
+namespace
+{
+
+// Counts the bytes allocated through it from the default resource.
+class Counter : public std::pmr::memory_resource
+{
+  public:
+    std::size_t allocated = 0;
+
+  private:
+    auto do_allocate(std::size_t bytes, std::size_t alignment) -> void * override
+    {
+        allocated += bytes;
+        return std::pmr::get_default_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *pointer, std::size_t bytes, std::size_t alignment) override
+    {
+        std::pmr::get_default_resource()->deallocate(pointer, bytes, alignment);
+    }
+
+    [[nodiscard]] auto do_is_equal(const std::pmr::memory_resource &other) const noexcept
+        -> bool override
+    {
+        return this == &other;
+    }
+};
+
+} // namespace
+
+TEST_CASE("Generate memoized collection", "[Generate]")
+{
+    // Each S tries A three times, so without memoization nested input takes 3^depth.
+    const auto ast = ast::Grammar(
+        ast::Definition(
+            ast::Identifier("S"),
+            ast::Alternative(ast::Sequence(ast::Identifier("A"), ast::Literal("x")),
+                             ast::Sequence(ast::Identifier("A"), ast::Literal("y")),
+                             ast::Identifier("A"))),
+        ast::Definition(ast::Identifier("A"),
+                        ast::Alternative(ast::Sequence(ast::Literal("("),
+                                                       ast::Identifier("S"),
+                                                       ast::Literal(")")),
+                                         ast::Literal("a"))));
+
+    SECTION("Memoized rules produce the same tree")
+    {
+        const auto plain = Generate(ast);
+        const auto packrat = Generate(ast, {.packrat = true});
+
+        const auto expected = UnwrapSuccess(plain.Parse("S", "((a)y)x"));
+        const auto actual = UnwrapSuccess(packrat.Parse("S", "((a)y)x"));
+        REQUIRE(actual.position == expected.position);
+        REQUIRE(actual.node.size() == 1);
+        REQUIRE(UnwrapNonTerminal(actual.node[0]).children.size() ==
+                UnwrapNonTerminal(expected.node[0]).children.size());
+    }
+    SECTION("Memoizing a single rule avoids exponential backtracking")
+    {
+        const auto collection = Generate(ast, {.memoize = {"A"}});
+        const std::string input = std::string(40, '(') + "a" + std::string(40, ')');
+
+        const auto result = UnwrapSuccess(collection.Parse("S", input));
+        REQUIRE(result.position == input.size());
+    }
+    SECTION("Memoized matches are not copied")
+    {
+        // Copying the nodes of every memoized match would take the square of the depth.
+        const auto packrat = Generate(ast, {.packrat = true});
+        const auto allocated = [&](std::size_t depth)
+        {
+            Counter counter;
+            Context context;
+            context.resource = &counter;
+            const std::string input =
+                std::string(depth, '(') + "a" + std::string(depth, ')');
+            const auto result = UnwrapSuccess(packrat.Parse("S", input, context));
+            REQUIRE(result.position == input.size());
+            return counter.allocated;
+        };
+        REQUIRE(allocated(400) < 3 * allocated(200));
+
+        const auto list = ast::Grammar(ast::Definition(
+            ast::Identifier("List"),
+            ast::Sequence(ast::Literal("("),
+                          ast::ZeroOrMore(ast::Identifier("List")),
+                          ast::Literal(")"))));
+        const std::string input = std::string(2000, '(') + std::string(2000, ')');
+        Counter plain;
+        Counter memoized;
+        Context context;
+        context.resource = &plain;
+        const auto expected = UnwrapSuccess(Generate(list).Parse("List", input, context));
+        context.resource = &memoized;
+        const auto lists = Generate(list, {.packrat = true});
+        const auto actual = UnwrapSuccess(lists.Parse("List", input, context));
+        REQUIRE(actual.node == expected.node);
+        REQUIRE(memoized.allocated < 2 * plain.allocated);
+    }
+    SECTION("Memoized rules evaluate nested input once")
+    {
+        std::size_t calls = 0;
+        std::map<std::string, Action> actions;
+        actions["A"] = [&calls](std::string_view, std::span<std::any> values)
+        {
+            calls++;
+            return std::any{values.empty() ? 0 : std::any_cast<int>(values[0]) + 1};
+        };
+        const auto collection = Generate(ast, {.packrat = true, .actions = actions});
+        const std::string input = std::string(40, '(') + "a" + std::string(40, ')');
+
+        // The values of memoized matches are replayed instead of evaluated again.
+        REQUIRE(collection.Evaluate<int>("S", input) == 40);
+        REQUIRE(calls == 41);
+        REQUIRE(collection.Evaluate<int>("S", "((a)y)x") == 2);
+    }
+    SECTION("Memoized rules visit nested input once")
+    {
+        const auto plain = Generate(ast);
+        const auto packrat = Generate(ast, {.packrat = true});
+        Recorder expected;
+        Recorder actual;
+        REQUIRE(plain.Visit("S", "((a)y)x", expected) == 7);
+        REQUIRE(packrat.Visit("S", "((a)y)x", actual) == 7);
+        REQUIRE(actual.text == expected.text);
+
+        // The events of memoized matches are replayed instead of matched again.
+        const std::string input = std::string(40, '(') + "a" + std::string(40, ')');
+        Recorder nested;
+        REQUIRE(packrat.Visit("S", input, nested) == input.size());
+        std::size_t entered = 0;
+        for (auto at = nested.text.find("(A@"); at != std::string::npos;
+             at = nested.text.find("(A@", at + 1))
+        {
+            entered++;
+        }
+        REQUIRE(entered == 41);
+    }
+    SECTION("Memoizing an undefined rule is an error")
+    {
+        REQUIRE_THROWS(Generate(ast, {.memoize = {"B"}}));
+    }
+    SECTION("Reused contexts forget earlier inputs")
+    {
+        const auto collection = Generate(ast, {.packrat = true});
+        Context context;
+
+        REQUIRE(UnwrapSuccess(collection.Parse("S", "((a)y)x", context)).position == 7);
+        REQUIRE(UnwrapSuccess(collection.Parse("S", "ax", context)).position == 2);
+        REQUIRE_NOTHROW(UnwrapFailure(collection.Parse("S", "(", context)));
+    }
+    SECTION("Collections are shared between threads")
+    {
+        const auto collection = Generate(ast, {.packrat = true});
+        const std::vector<std::string> inputs{"((a)y)x", "ax", "(((a)))", "(a", "a"};
+        std::vector<Result> expected;
+        for (const auto &input : inputs)
+        {
+            expected.push_back(collection.Parse("S", input));
+        }
+
+        std::atomic<int> mismatches = 0;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 8; t++)
+        {
+            threads.emplace_back(
+                [&]
+                {
+                    Context context;
+                    for (int round = 0; round < 200; round++)
+                    {
+                        for (std::size_t i = 0; i < inputs.size(); i++)
+                        {
+                            const auto actual = collection.Parse("S", inputs[i], context);
+                            if (actual.index() != expected[i].index() ||
+                                (std::holds_alternative<Success>(actual) &&
+                                 std::get<Success>(actual).node !=
+                                     std::get<Success>(expected[i]).node))
+                            {
+                                mismatches++;
+                            }
+                        }
+                    }
+                });
+        }
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        REQUIRE(mismatches == 0);
+    }
+    SECTION("Parse batches of inputs in order")
+    {
+        const auto collection = Generate(ast, {.packrat = true});
+        const std::vector<std::string> texts{"((a)y)x", "ax", "(((a)))", "(a", "a"};
+        std::vector<std::string_view> inputs;
+        for (int round = 0; round < 100; round++)
+        {
+            inputs.insert(inputs.end(), texts.begin(), texts.end());
+        }
+        for (const std::size_t jobs : {0, 1, 4})
+        {
+            const auto results = collection.ParseBatch("S", inputs, jobs);
+            REQUIRE(results.size() == inputs.size());
+            for (std::size_t i = 0; i < inputs.size(); i++)
+            {
+                const auto expected = collection.Parse("S", inputs[i]);
+                REQUIRE(results[i].index() == expected.index());
+                if (std::holds_alternative<Success>(expected))
+                {
+                    REQUIRE(std::get<Success>(results[i]).node ==
+                            std::get<Success>(expected).node);
+                }
+            }
+        }
+        REQUIRE(collection.ParseBatch("S", {}).empty());
+    }
+}
+
+TEST_CASE("Generate keyword alternatives", "[Generate]")
+{
+    const auto ast = ast::Grammar(
+        ast::Definition(ast::Identifier("Keyword"),
+                        ast::Alternative(ast::Literal("select"),
+                                         ast::Literal("sel"),
+                                         ast::Literal("from"),
+                                         ast::Literal("f"))),
+        ast::Definition(ast::Identifier("Operator"),
+                        ast::Class({ast::Range("<", ">")}, {ast::Literal("<=")})));
+    const auto collection = Generate(ast);
+
+    SECTION("First listed keyword wins")
+    {
+        REQUIRE(UnwrapSuccess(collection.Parse("Keyword", "select")).position == 6);
+        REQUIRE(UnwrapSuccess(collection.Parse("Keyword", "selec")).position == 3);
+        REQUIRE(UnwrapSuccess(collection.Parse("Keyword", "from")).position == 4);
+        REQUIRE(UnwrapSuccess(collection.Parse("Keyword", "fro")).position == 1);
+        REQUIRE_NOTHROW(UnwrapFailure(collection.Parse("Keyword", "where")));
+    }
+    SECTION("Classes with multi-byte members")
+    {
+        REQUIRE(UnwrapSuccess(collection.Parse("Operator", "<=")).position == 2);
+        REQUIRE(UnwrapSuccess(collection.Parse("Operator", "=>")).position == 1);
+        REQUIRE_NOTHROW(UnwrapFailure(collection.Parse("Operator", "!")));
+    }
+}
+
+TEST_CASE("Generate trees in an arena", "[Generate]")
+{
+    const auto ast = ast::Grammar(
+        ast::Definition(ast::Identifier("List"),
+                        ast::Sequence(ast::Identifier("Item"),
+                                      ast::ZeroOrMore(ast::Sequence(
+                                          ast::Literal(","), ast::Identifier("Item"))))),
+        ast::Definition(ast::Identifier("Item"),
+                        ast::Alternative(ast::Sequence(ast::Literal("("),
+                                                       ast::Identifier("List"),
+                                                       ast::Literal(")")),
+                                         ast::OneOrMore(ast::Range("a", "z")))));
+    const std::string input = "ab,(c,(d)),ef";
+
+    SECTION("Arena trees equal heap trees")
+    {
+        for (const bool packrat : {false, true})
+        {
+            const auto collection = Generate(ast, {.packrat = packrat});
+            Context context;
+            Arena arena;
+            const auto actual =
+                UnwrapSuccess(collection.Parse("List", input, context, arena));
+            const auto expected = UnwrapSuccess(collection.Parse("List", input));
+            REQUIRE(actual.position == input.size());
+            REQUIRE(actual.node == expected.node);
+        }
+    }
+    SECTION("Every node is allocated from the arena")
+    {
+        const auto collection = Generate(ast, {.packrat = true});
+        Context context;
+        Arena arena;
+        // UnwrapSuccess would copy the tree out of the arena.
+        const auto &parsed = collection.Parse("List", input, context, arena);
+        REQUIRE(std::holds_alternative<Success>(parsed));
+        const auto &result = std::get<Success>(parsed);
+
+        std::vector<const Nodes *> pending{&result.node};
+        while (!pending.empty())
+        {
+            const Nodes *nodes = pending.back();
+            pending.pop_back();
+            REQUIRE(nodes->get_allocator().resource() == arena.Resource());
+            for (const auto &node : *nodes)
+            {
+                if (std::holds_alternative<NonTerminal>(node))
+                {
+                    pending.push_back(&std::get<NonTerminal>(node).children);
+                }
+            }
+        }
+    }
+    SECTION("Arenas are reused after release")
+    {
+        const auto collection = Generate(ast);
+        Context context;
+        Arena arena{256};
+        for (int i = 0; i < 10; i++)
+        {
+            const auto &result = collection.Parse("List", input, context, arena);
+            REQUIRE(UnwrapSuccess(result).position == input.size());
+            REQUIRE_NOTHROW(UnwrapFailure(collection.Parse("List", ",", context, arena)));
+            arena.Release();
+        }
+    }
+}
+
+TEST_CASE("Recognize input without building trees", "[Generate]")
+{
+    const auto ast = ast::Grammar(
+        ast::Definition(ast::Identifier("Statement"),
+                        ast::Sequence(ast::And(ast::Identifier("Word")),
+                                      ast::Identifier("Word"),
+                                      ast::ZeroOrMore(ast::Sequence(
+                                          ast::Literal(" "), ast::Identifier("Word"))),
+                                      ast::Not(ast::Dot()))),
+        ast::Definition(ast::Identifier("Word"),
+                        ast::OneOrMore(ast::Class({ast::Range("a", "z")}, {}))));
+
+    for (const bool packrat : {false, true})
+    {
+        const auto collection = Generate(ast, {.packrat = packrat});
+        Context context;
+        for (const std::string input : {"abc", "ab cd e", "", "ab  c", "ab1"})
+        {
+            const auto parsed = collection.Parse("Statement", input);
+            const auto matched = collection.Match("Statement", input, context);
+            REQUIRE(matched.has_value() == std::holds_alternative<Success>(parsed));
+            if (matched)
+            {
+                REQUIRE(*matched == std::get<Success>(parsed).position);
+            }
+            // Nothing was ever appended to the output buffer.
+            REQUIRE(context.output.capacity() == 0);
+        }
+
+        // Predicates recognize Word before it is parsed for real at the same offset.
+        const auto parsed = collection.Parse("Statement", "ab cd", context);
+        const auto result = UnwrapSuccess(parsed);
+        const auto root = UnwrapNonTerminal(result.node[0]);
+        REQUIRE(root.children.size() == 3);
+        REQUIRE(UnwrapNonTerminal(root.children[0]).children.size() == 2);
+    }
+}
+
+TEST_CASE("Shape trees with rule annotations", "[Generate]")
+{
+    const auto grammar = [](ast::Shape spacing, ast::Shape value, ast::Shape number)
+    {
+        return ast::Grammar(
+            ast::Definition(ast::Identifier("List"),
+                            ast::Sequence(ast::Identifier("Value"),
+                                          ast::ZeroOrMore(ast::Sequence(
+                                              ast::Identifier("Spacing"),
+                                              ast::Identifier("Value"))))),
+            ast::Definition(ast::Identifier("Value"),
+                            ast::Alternative(ast::Identifier("Number"),
+                                             ast::Sequence(ast::Literal("("),
+                                                           ast::Identifier("List"),
+                                                           ast::Literal(")"))),
+                            value),
+            ast::Definition(ast::Identifier("Number"),
+                            ast::OneOrMore(ast::Class({ast::Range("0", "9")}, {})),
+                            number),
+            ast::Definition(
+                ast::Identifier("Spacing"), ast::ZeroOrMore(ast::Literal(" ")), spacing));
+    };
+    const auto parse = [](const ast::Grammar &ast, std::string_view input)
+    {
+        const auto result = UnwrapSuccess(Generate(ast).Parse("List", input));
+        return UnwrapNonTerminal(result.node[0]);
+    };
+    using enum ast::Shape;
+
+    SECTION("Skip rules")
+    {
+        const auto root = parse(grammar(Skip, Node, Node), "1  2");
+        REQUIRE(root.children.size() == 2);
+        REQUIRE(UnwrapNonTerminal(root.children[0]).type == "Value");
+        REQUIRE(UnwrapNonTerminal(root.children[1]).type == "Value");
+    }
+    SECTION("Inline rules into their parent")
+    {
+        const auto root = parse(grammar(Skip, Inline, Node), "1 (2)");
+        REQUIRE(root.children.size() == 4);
+        REQUIRE(UnwrapNonTerminal(root.children[0]).type == "Number");
+        REQUIRE(UnwrapTerminal(root.children[1]).value == "(");
+        REQUIRE(UnwrapNonTerminal(root.children[2]).type == "List");
+    }
+    SECTION("Collapse rules with a single child")
+    {
+        const auto root = parse(grammar(Skip, Collapse, Node), "1 (2)");
+        REQUIRE(root.children.size() == 2);
+        REQUIRE(UnwrapNonTerminal(root.children[0]).type == "Number");
+        REQUIRE(UnwrapNonTerminal(root.children[1]).type == "Value");
+        REQUIRE(UnwrapNonTerminal(root.children[1]).children.size() == 3);
+    }
+    SECTION("Capture rules as one token")
+    {
+        const auto root = parse(grammar(Skip, Inline, Token), "12 345");
+        REQUIRE(root.children.size() == 2);
+        REQUIRE(UnwrapTerminal(root.children[0]).value == "12");
+        REQUIRE(UnwrapTerminal(root.children[1]).value == "345");
+    }
+    SECTION("Recognize shaped grammars")
+    {
+        const auto collection =
+            Generate(grammar(Skip, Collapse, Token));
+        REQUIRE(collection.Match("List", "1 (2 3)") == 7);
+        REQUIRE_FALSE(collection.Match("List", "(1").has_value());
+    }
+}
+
+TEST_CASE("Evaluate rules with semantic actions", "[Generate]")
+{
+    const auto ast = ast::Grammar(
+        ast::Definition(ast::Identifier("Start"),
+                        ast::Sequence(ast::And(ast::Identifier("Sum")),
+                                      ast::Identifier("Sum"),
+                                      ast::Not(ast::Dot()))),
+        ast::Definition(ast::Identifier("Sum"),
+                        ast::Sequence(ast::Identifier("Term"),
+                                      ast::ZeroOrMore(ast::Sequence(
+                                          ast::Literal("+"), ast::Identifier("Term"))))),
+        ast::Definition(ast::Identifier("Term"),
+                        ast::Alternative(ast::Identifier("Factorial"),
+                                         ast::Identifier("Number"),
+                                         ast::Sequence(ast::Literal("("),
+                                                       ast::Identifier("Sum"),
+                                                       ast::Literal(")")))),
+        ast::Definition(ast::Identifier("Factorial"),
+                        ast::Sequence(ast::Identifier("Number"), ast::Literal("!"))),
+        ast::Definition(ast::Identifier("Number"),
+                        ast::OneOrMore(ast::Class({ast::Range("0", "9")}, {}))));
+
+    std::map<std::string, Action> actions;
+    actions["Number"] = [](std::string_view text, std::span<std::any>)
+    { return std::any{std::stoi(std::string(text))}; };
+    actions["Factorial"] = [](std::string_view, std::span<std::any> values)
+    {
+        int product = 1;
+        for (int i = 2; i <= std::any_cast<int>(values[0]); i++)
+        {
+            product *= i;
+        }
+        return std::any{product};
+    };
+    actions["Sum"] = [](std::string_view, std::span<std::any> values)
+    {
+        int sum = 0;
+        for (const auto &value : values)
+        {
+            sum += std::any_cast<int>(value);
+        }
+        return std::any{sum};
+    };
+
+    for (const bool packrat : {false, true})
+    {
+        // Values of abandoned alternatives and of predicates are discarded.
+        const auto collection = Generate(ast, {.packrat = packrat, .actions = actions});
+        REQUIRE(collection.Evaluate<int>("Start", "1+3!+(2+2)") == 11);
+        REQUIRE(collection.Evaluate<int>("Start", "(4)!") == std::nullopt);
+
+        Context context;
+        for (int i = 0; i < 3; i++)
+        {
+            const auto value = collection.Evaluate("Start", "2+2", context);
+            REQUIRE(std::any_cast<int>(*value) == 4);
+        }
+        REQUIRE(context.values.empty());
+
+        // Parsing is unaffected by the actions.
+        const auto result = UnwrapSuccess(collection.Parse("Start", "2!"));
+        REQUIRE(UnwrapNonTerminal(result.node[0]).type == "Start");
+    }
+
+    SECTION("Grammars without actions produce no value")
+    {
+        const auto value = Generate(ast).Evaluate("Start", "1+2");
+        REQUIRE(value.has_value());
+        REQUIRE_FALSE(value->has_value());
+    }
+    SECTION("Reject actions for undefined rules")
+    {
+        REQUIRE_THROWS(Generate(ast, {.actions = {{"Product", actions["Sum"]}}}));
+    }
+    SECTION("Reuse the context after an action throws")
+    {
+        const auto collection = Generate(ast, {.actions = actions});
+        Context context;
+        REQUIRE_THROWS_AS(collection.Evaluate("Start", "99999999999999999999", context),
+                          std::out_of_range);
+        REQUIRE(context.build);
+        REQUIRE_FALSE(context.evaluate);
+        const auto result = UnwrapSuccess(collection.Parse("Number", "12", context));
+        REQUIRE(result.node.size() == 1);
+    }
+}
+
+namespace
+{
+
+// Writes the tokens and the nesting of nodes, ignoring offsets.
+auto Serialize(const Node &node) -> std::string
+{
+    if (std::holds_alternative<Terminal>(node))
+    {
+        return "'" + std::string(std::get<Terminal>(node).value) + "' ";
+    }
+    const auto &nonterminal = std::get<NonTerminal>(node);
+    std::string text = "(" + std::string(nonterminal.type) + " ";
+    for (const auto &child : nonterminal.children)
+    {
+        text += Serialize(child);
+    }
+    return text + std::string(nonterminal.type) + ") ";
+}
+
+} // namespace
+
+TEST_CASE("Visit matches without building trees", "[Generate]")
+{
+    using enum ast::Shape;
+    const auto ast = ast::Grammar(
+        ast::Definition(ast::Identifier("List"),
+                        ast::Sequence(ast::ZeroOrMore(ast::Identifier("Item")),
+                                      ast::Not(ast::Dot()))),
+        ast::Definition(ast::Identifier("Item"),
+                        ast::Alternative(ast::Sequence(ast::Identifier("Word"),
+                                                       ast::Literal("!")),
+                                         ast::Sequence(ast::Identifier("Word"),
+                                                       ast::Optional(ast::Literal("?"))),
+                                         ast::Identifier("Group")),
+                        Collapse),
+        ast::Definition(ast::Identifier("Group"),
+                        ast::Sequence(ast::Literal("("),
+                                      ast::ZeroOrMore(ast::Identifier("Item")),
+                                      ast::Literal(")"))),
+        ast::Definition(ast::Identifier("Word"),
+                        ast::OneOrMore(ast::Class({ast::Range("a", "z")}, {}))));
+
+    for (const bool packrat : {false, true})
+    {
+        const auto collection = Generate(ast, {.packrat = packrat});
+        Context context;
+        for (const std::string input : {"ab!c?(de!)", "a(b(c?)d)", "", "ab!(c"})
+        {
+            Recorder recorder;
+            const auto end = collection.Visit("List", input, recorder, context);
+            const auto result = collection.Parse("List", input);
+            REQUIRE(end.has_value() == std::holds_alternative<Success>(result));
+            if (!end)
+            {
+                continue;
+            }
+            REQUIRE(*end == input.size());
+            // Apart from the offsets, the events describe the same tree.
+            std::string events;
+            for (std::size_t i = 0; i < recorder.text.size(); i++)
+            {
+                if (recorder.text[i] == '@')
+                {
+                    i = recorder.text.find_first_of(" )", i) - 1;
+                    continue;
+                }
+                events += recorder.text[i];
+            }
+            REQUIRE(events == Serialize(UnwrapSuccess(result).node[0]));
+        }
+    }
+
+    SECTION("Report offsets")
+    {
+        Recorder recorder;
+        REQUIRE(Generate(ast).Visit("List", "ab?", recorder) == 3);
+        REQUIRE(recorder.text == "(List@0 (Item@0 (Word@0 'a' 'b' Word@0-2) '?' "
+                                 "Item@0-3) List@0-3) ");
+    }
+    SECTION("Deliver events while parsing")
+    {
+        // Counts the events still buffered each time a Word is delivered.
+        class Watcher : public Visitor
+        {
+          public:
+            explicit Watcher(const Context &context) : context{&context} {}
+            void OnEnter(std::string_view rule, std::size_t /*offset*/) override
+            {
+                if (rule == "Word")
+                {
+                    words++;
+                    buffered = std::max(buffered, context->events.size());
+                }
+            }
+
+            const Context *context;
+            std::size_t words = 0;
+            std::size_t buffered = 0;
+        };
+
+        std::string input;
+        for (int i = 0; i < 1000; i++)
+        {
+            input += "abc?";
+        }
+        Context context;
+        Watcher watcher{context};
+        REQUIRE(Generate(ast).Visit("List", input, watcher, context) == input.size());
+        REQUIRE(watcher.words == 1000);
+        REQUIRE(watcher.buffered < 16);
+    }
+    SECTION("Reuse the context after a visitor throws")
+    {
+        class Thrower : public Visitor
+        {
+          public:
+            void OnToken(std::string_view /*token*/) override
+            {
+                throw std::runtime_error("Stop");
+            }
+        };
+
+        const auto collection = Generate(ast);
+        Context context;
+        {
+            Thrower thrower;
+            REQUIRE_THROWS(collection.Visit("List", "ab", thrower, context));
+        }
+        REQUIRE(context.visitor == nullptr);
+        REQUIRE(context.build);
+        const auto result = UnwrapSuccess(collection.Parse("List", "ab", context));
+        REQUIRE(Serialize(result.node[0]) == "(List (Word 'a' 'b' Word) List) ");
+    }
+}
+
+TEST_CASE("Iterate over records", "[Generate]")
+{
+    const auto ast = ast::Grammar(
+        ast::Definition(ast::Identifier("Line"),
+                        ast::Sequence(ast::Identifier("Word"),
+                                      ast::Optional(ast::Literal("\n")))),
+        ast::Definition(ast::Identifier("Word"),
+                        ast::OneOrMore(ast::Class({ast::Range("a", "z")}, {}))));
+    static_assert(std::ranges::input_range<Records>);
+
+    // Sections only run once per run of the test case, so each covers both modes.
+    const std::array<Collection, 2> collections{Generate(ast),
+                                                Generate(ast, {.packrat = true})};
+
+    SECTION("Parse each record")
+    {
+        for (const auto &collection : collections)
+        {
+            Context context;
+            const std::string input = "ab\ncde\nf";
+            auto records = collection.Records("Line", input, context);
+            std::vector<std::string> words;
+            std::vector<std::size_t> ends;
+            for (const Success &record : records)
+            {
+                const auto line = UnwrapNonTerminal(record.node[0]);
+                std::string word;
+                for (const auto &letter : UnwrapNonTerminal(line.children[0]).children)
+                {
+                    word += UnwrapTerminal(letter).value;
+                }
+                words.push_back(word);
+                ends.push_back(record.position);
+                // Only the current record is held.
+                REQUIRE(context.output.empty());
+                for (const auto &table : context.memo)
+                {
+                    REQUIRE(table.size() <= 2);
+                }
+            }
+            REQUIRE(words == std::vector<std::string>{"ab", "cde", "f"});
+            REQUIRE(ends == std::vector<std::size_t>{3, 7, 8});
+            REQUIRE(records.Position() == input.size());
+        }
+    }
+    SECTION("Stop at the first record that does not match")
+    {
+        for (const auto &collection : collections)
+        {
+            Context context;
+            const std::string input = "ab\n12\ncd\n";
+            auto records = collection.Records("Line", input, context);
+            REQUIRE(std::ranges::distance(records) == 1);
+            REQUIRE(records.Position() == 3);
+        }
+    }
+    SECTION("Iterate over empty input")
+    {
+        for (const auto &collection : collections)
+        {
+            Context context;
+            auto records = collection.Records("Line", "", context);
+            REQUIRE(records.begin() == records.end());
+            REQUIRE(records.Position() == 0);
+        }
+    }
+}
+
+TEST_CASE("Parse one input in parallel", "[Generate]")
+{
+    // Quoted strings may contain newlines, so some newlines are not record boundaries.
+    const auto ast = ast::Grammar(
+        ast::Definition(ast::Identifier("File"),
+                        ast::ZeroOrMore(ast::Identifier("Record"))),
+        ast::Definition(
+            ast::Identifier("Record"),
+            ast::Sequence(ast::OneOrMore(ast::Class({ast::Range("a", "z")}, {})),
+                          ast::Optional(ast::Sequence(
+                              ast::Literal("\""),
+                              ast::ZeroOrMore(ast::Sequence(ast::Not(ast::Literal("\"")),
+                                                            ast::Dot())),
+                              ast::Literal("\""))),
+                          ast::Literal("\n"))),
+        ast::Definition(ast::Identifier("Newline"), ast::Literal("\n")));
+    const auto collection = Generate(ast, {.packrat = true});
+
+    std::string records;
+    for (int i = 0; i < 200; i++)
+    {
+        records += i % 3 == 0 ? "ab\"x\ny\nz\"\n" : "cd\n";
+    }
+    const std::vector<std::string> inputs{records, records + "12\nab\n", "ab\n", ""};
+    for (const auto &input : inputs)
+    {
+        const auto sequential = UnwrapSuccess(collection.Parse("File", input));
+        const auto expected = UnwrapNonTerminal(sequential.node[0]).children;
+        for (const std::size_t jobs : {1, 2, 3, 7, 16})
+        {
+            const auto result =
+                collection.ParseParallel("Record", "Newline", input, jobs);
+            REQUIRE(result.position == sequential.position);
+            REQUIRE(result.node == expected);
+        }
+    }
 }
@@ -16,8 +16,8 @@ auto UnwrapFailure(const Result &result) -> Failure
         return std::get<Failure>(result);
     }
     const auto success = std::get<Success>(result);
-    throw std::runtime_error("Failed to unwrap parser failure. Remainder: " +
-                             success.remainder);
+    throw std::runtime_error("Failed to unwrap parser failure. Position: " +
+                             std::to_string(success.position));
 }
 
 auto UnwrapTerminal(const Node &node) -> Terminal
@@ -37,3 +37,19 @@ auto UnwrapNonTerminal(const Node &node) -> NonTerminal
     }
     throw std::runtime_error("Failed to unwrap NonTerminal");
 }
+
+void Recorder::OnEnter(std::string_view rule, std::size_t offset)
+{
+    text += "(" + std::string(rule) + "@" + std::to_string(offset) + " ";
+}
+
+void Recorder::OnExit(std::string_view rule, std::size_t start, std::size_t end)
+{
+    text += std::string(rule) + "@" + std::to_string(start) + "-" + std::to_string(end) +
+            ") ";
+}
+
+void Recorder::OnToken(std::string_view token)
+{
+    text += "'" + std::string(token) + "' ";
+}
@@ -2,6 +2,8 @@
 
 #include "parser.hpp"
 
+#include <string>
+
 auto UnwrapSuccess(const Result &result) -> Success;
 
 auto UnwrapFailure(const Result &result) -> Failure;
@@ -9,3 +11,15 @@ auto UnwrapFailure(const Result &result) -> Failure;
 auto UnwrapTerminal(const Node &node) -> Terminal;
 
 auto UnwrapNonTerminal(const Node &node) -> NonTerminal;
+
+// Writes the events it receives as text: "(Rule@start " on entry, "Rule@start-end) "
+// on exit and "'token' " for tokens.
+class Recorder : public Visitor
+{
+  public:
+    void OnEnter(std::string_view rule, std::size_t offset) override;
+    void OnExit(std::string_view rule, std::size_t start, std::size_t end) override;
+    void OnToken(std::string_view token) override;
+
+    std::string text;
+};
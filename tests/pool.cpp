@@ -0,0 +1,84 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <latch>
+#include <stdexcept>
+#include <vector>
+
+TEST_CASE("Run tasks on a work-stealing pool", "[Pool]")
+{
+    SECTION("Bound the number of workers")
+    {
+        REQUIRE(Workers(4, 100) == 4);
+        REQUIRE(Workers(4, 2) == 2);
+        REQUIRE(Workers(4, 0) == 1);
+        REQUIRE(Workers(0, 100) >= 1);
+    }
+    SECTION("Run every task exactly once")
+    {
+        for (const std::size_t jobs : {1, 3, 8})
+        {
+            for (const std::size_t count : {0, 1, 7, 1000})
+            {
+                std::vector<std::atomic<int>> runs(count);
+                std::vector<std::atomic<int>> busy(Workers(jobs, count));
+                std::atomic<bool> overlapped = false;
+                ParallelFor(count,
+                            jobs,
+                            [&](std::size_t worker, std::size_t index)
+                            {
+                                // Tasks of one worker never overlap.
+                                if (busy[worker]++ != 0)
+                                {
+                                    overlapped = true;
+                                }
+                                runs[index]++;
+                                busy[worker]--;
+                            });
+                REQUIRE_FALSE(overlapped);
+                for (const auto &run : runs)
+                {
+                    REQUIRE(run == 1);
+                }
+            }
+        }
+    }
+    SECTION("Steal tasks from busy workers")
+    {
+        // Worker 0 owns the first half and blocks on its first task until worker 1 has
+        // run one of its indices, which worker 1 can only get by stealing.
+        std::vector<std::size_t> owners(64);
+        std::latch stolen{1};
+        std::atomic<bool> released = false;
+        ParallelFor(owners.size(),
+                    2,
+                    [&](std::size_t worker, std::size_t index)
+                    {
+                        owners[index] = worker;
+                        if (worker == 0 && index == 0)
+                        {
+                            stolen.wait();
+                        }
+                        else if (worker == 1 && index < 32 && !released.exchange(true))
+                        {
+                            stolen.count_down();
+                        }
+                    });
+        REQUIRE(released);
+        REQUIRE(std::find(owners.begin(), owners.begin() + 32, 1) != owners.begin() + 32);
+    }
+    SECTION("Propagate exceptions")
+    {
+        const auto fail = [](std::size_t /*worker*/, std::size_t index)
+        {
+            if (index == 5)
+            {
+                throw std::runtime_error("Failed task");
+            }
+        };
+        REQUIRE_THROWS_AS(ParallelFor(10, 3, fail), std::runtime_error);
+    }
+}
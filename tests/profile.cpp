@@ -0,0 +1,119 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "generator.hpp"
+#include "profile.hpp"
+#include "reader.hpp"
+
+#include <sstream>
+#include <string>
+
+TEST_CASE("Profile rules", "[Profile]")
+{
+    const auto grammar = ReadGrammar("A <- B 'x' / B 'y'\n"
+                                     "B <- [ab]+\n");
+    Profile profile;
+    Context context;
+    context.profile = &profile;
+
+    SECTION("Count calls and backtracking")
+    {
+        const auto collection = Generate(grammar, {.instrument = true});
+        REQUIRE(collection.Match("A", "aby", context) == 3);
+        REQUIRE(collection.Match("A", "abz", context) == std::nullopt);
+
+        const auto &a = profile.Rules().at(0);
+        REQUIRE(a.name == "A");
+        REQUIRE(a.calls == 2);
+        REQUIRE(a.successes == 1);
+        REQUIRE(a.failures == 1);
+        REQUIRE(a.consumed == 3);
+        REQUIRE(a.rescanned == 0);
+        // The failed call of A got as far as the B it called.
+        REQUIRE(a.abandoned == 2);
+        // A only calls B, so its time is its own plus that of B.
+        const auto &b = profile.Rules().at(1);
+        REQUIRE(a.inclusive == a.exclusive + b.exclusive);
+
+        REQUIRE(b.name == "B");
+        REQUIRE(b.calls == 4);
+        REQUIRE(b.successes == 4);
+        REQUIRE(b.consumed == 8);
+        // The second alternative matches B again, once per parse.
+        REQUIRE(b.rescanned == 4);
+        REQUIRE(b.abandoned == 0);
+    }
+    SECTION("Only count bytes matched before as rescanned")
+    {
+        const auto match = [&profile](std::size_t start, std::size_t end)
+        {
+            profile.Enter(0, "R", start);
+            profile.Exit(end);
+        };
+        profile.Begin();
+        match(0, 5);
+        match(10, 20);
+        REQUIRE(profile.Rules().at(0).rescanned == 0);
+        match(7, 12);
+        REQUIRE(profile.Rules().at(0).rescanned == 2);
+        // The spans are now [0, 5) and [7, 20), which leaves a gap.
+        match(3, 15);
+        REQUIRE(profile.Rules().at(0).rescanned == 12);
+        match(20, 22);
+        REQUIRE(profile.Rules().at(0).rescanned == 12);
+        // A new parse has matched nothing yet.
+        profile.Begin();
+        match(0, 22);
+        REQUIRE(profile.Rules().at(0).rescanned == 12);
+        REQUIRE(profile.Rules().at(0).consumed == 5 + 10 + 5 + 12 + 2 + 22);
+    }
+    SECTION("Recursive calls do not rescan the input of the calls they made")
+    {
+        const auto nested = Generate(ReadGrammar("N <- '(' N ')' / 'x'\n"),
+                                     {.instrument = true});
+        REQUIRE(nested.Match("N", "((((x))))", context) == 9);
+        REQUIRE(profile.Rules().at(0).consumed == 1 + 3 + 5 + 7 + 9);
+        REQUIRE(profile.Rules().at(0).rescanned == 0);
+
+        // Matching M again after backtracking still counts at any depth: the innermost
+        // M matches its byte three more times, and the M around it its three bytes
+        // once more.
+        profile.Clear();
+        const auto retried =
+            Generate(ReadGrammar("M <- '(' M ')' 'y' / '(' M ')' / 'x'\n"),
+                     {.instrument = true});
+        REQUIRE(retried.Match("M", "((x))", context) == 5);
+        REQUIRE(profile.Rules().at(0).rescanned == 1 + 1 + 1 + 3);
+    }
+    SECTION("Memoized results are not calls")
+    {
+        const auto collection = Generate(grammar, {.packrat = true, .instrument = true});
+        REQUIRE(collection.Match("A", "aby", context) == 3);
+        REQUIRE(profile.Rules().at(1).calls == 1);
+        REQUIRE(profile.Rules().at(1).rescanned == 0);
+    }
+    SECTION("Write the table and folded stacks")
+    {
+        const auto collection = Generate(grammar, {.instrument = true});
+        REQUIRE(collection.Parse("A", "aby", context).index() == 0);
+
+        std::ostringstream table;
+        profile.WriteTable(table);
+        REQUIRE(table.str().starts_with("rule"));
+        REQUIRE(table.str().find("\nA ") != std::string::npos);
+        REQUIRE(table.str().find("\nB ") != std::string::npos);
+
+        std::ostringstream folded;
+        profile.WriteFolded(folded);
+        REQUIRE(folded.str().starts_with("A "));
+        REQUIRE(folded.str().find("\nA;B ") != std::string::npos);
+
+        profile.Clear();
+        REQUIRE(profile.Rules().empty());
+    }
+    SECTION("Rules are not instrumented by default")
+    {
+        const auto collection = Generate(grammar);
+        REQUIRE(collection.Match("A", "aby", context) == 3);
+        REQUIRE(profile.Rules().empty());
+    }
+}
@@ -0,0 +1,44 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "helpers.hpp"
+
+#include "generator.hpp"
+#include "reader.hpp"
+
+TEST_CASE("Read grammar text", "[ReadGrammar]")
+{
+    SECTION("Read definitions in order")
+    {
+        const auto grammar = ReadGrammar("A <- B C / 'a'\n"
+                                         "B <- [0-9]+ # digits\n"
+                                         "C <- !. &\"c\"?\n");
+        REQUIRE(grammar.definitions.size() == 3);
+        REQUIRE(grammar.definitions[0].identifier.value == "A");
+        REQUIRE(grammar.definitions[1].identifier.value == "B");
+        REQUIRE(grammar.definitions[2].identifier.value == "C");
+        REQUIRE(ast::ToString(grammar) == "A <- B C  / 'a'\n"
+                                          "B <- [0-9]+\n"
+                                          "C <- !. &('c')? \n");
+    }
+    SECTION("Decode escapes in literals and classes")
+    {
+        const auto grammar = ReadGrammar("Escapes <- '\\n' \"\\\"\" [\\101-\\132\\-]\n");
+        const auto collection = Generate(grammar);
+        const auto result = UnwrapSuccess(collection.Parse("Escapes", "\n\"Q"));
+        REQUIRE(result.position == 3);
+        REQUIRE_NOTHROW(UnwrapSuccess(collection.Parse("Escapes", "\n\"-")));
+        REQUIRE_NOTHROW(UnwrapFailure(collection.Parse("Escapes", "\n\"a")));
+    }
+    SECTION("Parse with a grammar read from text")
+    {
+        const auto grammar = ReadGrammar("List <- Item (',' Item)*\n"
+                                         "Item <- [a-z]+\n");
+        const auto collection = Generate(grammar);
+        const auto result = UnwrapSuccess(collection.Parse("List", "ab,c"));
+        REQUIRE(result.position == 4);
+        const auto root = UnwrapNonTerminal(result.node[0]);
+        REQUIRE(root.children.size() == 3);
+        REQUIRE(UnwrapNonTerminal(root.children[2]).type == "Item");
+    }
+    SECTION("Reject invalid grammars") { REQUIRE_THROWS(ReadGrammar("A <- (B")); }
+}
@@ -0,0 +1,99 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "helpers.hpp"
+
+#include "combinator.hpp"
+#include "static_combinator.hpp"
+
+namespace s = static_combinator;
+
+namespace
+{
+
+// Parses input with both forms of a parser and checks they agree.
+template <typename Static>
+auto Same(const Parser &dynamic, std::string_view input) -> bool
+{
+    const Result expected = Parse(dynamic, input);
+    const Result actual = s::Parse<Static>(input);
+    if (std::holds_alternative<Failure>(expected))
+    {
+        return std::holds_alternative<Failure>(actual);
+    }
+    return std::holds_alternative<Success>(actual) &&
+           std::get<Success>(actual).position == std::get<Success>(expected).position &&
+           std::get<Success>(actual).node == std::get<Success>(expected).node;
+}
+
+struct Value;
+struct Sum : s::Def<"Sum", s::Seq<Value, s::Star<s::Seq<s::Lit<"+">, Value>>>>
+{
+};
+struct Value
+    : s::Def<"Value",
+             s::Alt<s::Plus<s::Rng<'0', '9'>>, s::Seq<s::Lit<"(">, Sum, s::Lit<")">>>>
+{
+};
+
+} // namespace
+
+TEST_CASE("Static parsers match dynamic parsers", "[Static]")
+{
+    using namespace combinator;
+
+    SECTION("Terminals")
+    {
+        for (const auto *input : {"", "a", "ab", "abc", "b"})
+        {
+            REQUIRE(Same<s::Lit<"ab">>(Literal("ab"), input));
+            REQUIRE(Same<s::Rng<'a', 'b'>>(Range("a", "b"), input));
+            REQUIRE(Same<s::Any>(Dot(), input));
+        }
+    }
+    SECTION("Sequences and alternatives")
+    {
+        const auto sequence = Sequence({Literal("A"), Literal("B"), Literal("C")});
+        const auto alternative = Alternative({Literal("AB"), Literal("A"), Literal("C")});
+        for (const auto *input : {"", "A", "ABC", "ABD", "C"})
+        {
+            REQUIRE(Same<s::Seq<s::Lit<"A">, s::Lit<"B">, s::Lit<"C">>>(sequence, input));
+            REQUIRE(Same<s::Alt<s::Lit<"AB">, s::Lit<"A">, s::Lit<"C">>>(alternative,
+                                                                         input));
+        }
+    }
+    SECTION("Repetition and predicates")
+    {
+        for (const auto *input : {"", "0", "0001", "1"})
+        {
+            REQUIRE(Same<s::Opt<s::Lit<"0">>>(Optional(Literal("0")), input));
+            REQUIRE(Same<s::Star<s::Lit<"0">>>(ZeroOrMore(Literal("0")), input));
+            REQUIRE(Same<s::Plus<s::Lit<"0">>>(OneOrMore(Literal("0")), input));
+            REQUIRE(Same<s::And<s::Lit<"0">>>(And(Literal("0")), input));
+            REQUIRE(Same<s::Not<s::Lit<"0">>>(Not(Literal("0")), input));
+        }
+    }
+    SECTION("Definitions")
+    {
+        const auto dynamic =
+            Definition(Sequence({OneOrMore(Literal("0")), OneOrMore(Literal("1"))}),
+                       "ZerosAndOnes");
+        using Static =
+            s::Def<"ZerosAndOnes", s::Seq<s::Plus<s::Lit<"0">>, s::Plus<s::Lit<"1">>>>;
+        for (const auto *input : {"", "0", "0000011111", "111000"})
+        {
+            REQUIRE(Same<Static>(dynamic, input));
+        }
+    }
+    SECTION("Recursive rules")
+    {
+        const auto res = UnwrapSuccess(s::Parse<Sum>("1+(2+34)"));
+        REQUIRE(res.position == 8);
+        const auto root = UnwrapNonTerminal(res.node[0]);
+        REQUIRE(root.type == "Sum");
+        REQUIRE(root.children.size() == 3);
+        const auto nested = UnwrapNonTerminal(root.children[2]);
+        REQUIRE(nested.type == "Value");
+        REQUIRE(UnwrapNonTerminal(nested.children[1]).type == "Sum");
+        REQUIRE_NOTHROW(UnwrapFailure(s::Parse<Sum>("+1")));
+    }
+}
@@ -0,0 +1,113 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "helpers.hpp"
+
+#include "ast.hpp"
+#include "grammar.hpp"
+#include "tape.hpp"
+#include "vm.hpp"
+
+#include <utility>
+
+TEST_CASE("Flat parse tapes", "[Tape]")
+{
+    const auto ast = ast::Grammar(
+        ast::Definition(
+            ast::Identifier("Sum"),
+            ast::Sequence(ast::Identifier("Number"),
+                          ast::ZeroOrMore(ast::Sequence(ast::Literal("+"),
+                                                        ast::Identifier("Number"))))),
+        ast::Definition(ast::Identifier("Number"),
+                        ast::OneOrMore(ast::Class({ast::Range("0", "9")}, {}))));
+    const auto program = vm::Compile(ast);
+
+    SECTION("Store one entry per node in pre-order")
+    {
+        const auto tape = program.ParseTape("Sum", "12+3");
+        REQUIRE(tape.has_value());
+        REQUIRE(tape->position == 4);
+        // Sum, Number, "1", "2", "+", Number, "3"
+        REQUIRE(tape->entries.size() == 7);
+        REQUIRE(tape->entries[0].size == 7);
+        REQUIRE(tape->entries[1].size == 3);
+        REQUIRE(tape->entries[4].rule == Tape::Token);
+    }
+    SECTION("Walk children and siblings with cursors")
+    {
+        const auto tape = program.ParseTape("Sum", "12+3");
+        const auto root = tape->Root();
+        REQUIRE(root.has_value());
+        REQUIRE(root->Type() == "Sum");
+        REQUIRE(root->Value() == "12+3");
+        REQUIRE_FALSE(root->NextSibling().has_value());
+
+        std::vector<std::string_view> children;
+        for (auto child = root->FirstChild(); child; child = child->NextSibling())
+        {
+            children.push_back(child->IsToken() ? child->Value() : child->Type());
+        }
+        REQUIRE(children == std::vector<std::string_view>{"Number", "+", "Number"});
+
+        const auto number = root->FirstChild();
+        REQUIRE(number->Start() == 0);
+        REQUIRE(number->End() == 2);
+        const auto digit = number->FirstChild();
+        REQUIRE(digit->IsToken());
+        REQUIRE_FALSE(digit->FirstChild().has_value());
+        REQUIRE(digit->NextSibling()->Value() == "2");
+        REQUIRE_FALSE(digit->NextSibling()->NextSibling().has_value());
+    }
+    SECTION("Outlive moves of the program")
+    {
+        auto moved = vm::Compile(ast);
+        const auto tape = moved.ParseTape("Sum", "1+2");
+        const auto owner = std::move(moved);
+        REQUIRE(tape->Root()->Type() == "Sum");
+        REQUIRE(UnwrapNonTerminal(tape->ToNodes()[0]).type == "Sum");
+    }
+    SECTION("Report failures")
+    {
+        REQUIRE_FALSE(program.ParseTape("Sum", "+1").has_value());
+        REQUIRE_THROWS(program.ParseTape("Missing", "1"));
+    }
+    SECTION("Convert to the equivalent tree")
+    {
+        const std::string input = "Expression <- Number (Plus / Minus) Number\n"
+                                  "Plus <- '+'  # addition\n"
+                                  "Minus <- !Plus '-'\n"
+                                  "Number <- [0-9]+ .?\n";
+        const auto peg = vm::Compile(GetPegGrammarAST());
+        const auto expected = UnwrapSuccess(peg.Parse("Grammar", input));
+        const auto tape = peg.ParseTape("Grammar", input);
+        REQUIRE(tape->position == expected.position);
+        REQUIRE(tape->ToNodes() == expected.node);
+    }
+    SECTION("Apply rule shapes when converting")
+    {
+        const auto shaped = vm::Compile(ast::Grammar(
+            ast::Definition(ast::Identifier("L"),
+                            ast::Sequence(ast::Identifier("S"),
+                                          ast::Literal("x"),
+                                          ast::Identifier("I"),
+                                          ast::Identifier("C"),
+                                          ast::Identifier("T"))),
+            ast::Definition(ast::Identifier("S"), ast::Literal("s"), ast::Shape::Skip),
+            ast::Definition(ast::Identifier("I"),
+                            ast::Sequence(ast::Literal("i"), ast::Literal("j")),
+                            ast::Shape::Inline),
+            ast::Definition(
+                ast::Identifier("C"), ast::Identifier("N"), ast::Shape::Collapse),
+            ast::Definition(ast::Identifier("N"), ast::Literal("n")),
+            ast::Definition(ast::Identifier("T"),
+                            ast::OneOrMore(ast::Literal("t")),
+                            ast::Shape::Token)));
+        const auto expected = UnwrapSuccess(shaped.Parse("L", "sxijntt"));
+        const auto tape = shaped.ParseTape("L", "sxijntt");
+        // The tape keeps every match: L, S, "s", "x", I, "i", "j", C, N, "n", T, "t", "t"
+        REQUIRE(tape->entries.size() == 13);
+        const auto nodes = tape->ToNodes();
+        REQUIRE(nodes == expected.node);
+        // "x", "i", "j", N and "tt"
+        REQUIRE(UnwrapNonTerminal(nodes[0]).children.size() == 5);
+    }
+}
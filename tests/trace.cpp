@@ -0,0 +1,78 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "generator.hpp"
+#include "reader.hpp"
+#include "trace.hpp"
+
+#include <sstream>
+#include <string>
+
+namespace
+{
+
+auto Count(const std::string &text, const std::string &pattern) -> std::size_t
+{
+    std::size_t count = 0;
+    for (auto at = text.find(pattern); at != std::string::npos;
+         at = text.find(pattern, at + 1))
+    {
+        count++;
+    }
+    return count;
+}
+
+} // namespace
+
+TEST_CASE("Trace rule calls", "[Tracer]")
+{
+    const auto collection = Generate(ReadGrammar("A <- B 'x' / B 'y'\n"
+                                                 "B <- [ab]+\n"),
+                                     {.instrument = true});
+    std::ostringstream stream;
+    Context context;
+
+    SECTION("Record every call")
+    {
+        {
+            Tracer tracer{stream};
+            context.tracer = &tracer;
+            REQUIRE(collection.Match("A", "aby", context) == 3);
+            REQUIRE(collection.Match("A", "abz", context) == std::nullopt);
+        }
+        const std::string trace = stream.str();
+        REQUIRE(trace.starts_with("{\"traceEvents\": ["));
+        REQUIRE(trace.ends_with("]}\n"));
+        REQUIRE(Count(trace, "\"ph\": \"X\"") == 6);
+        REQUIRE(Count(trace, "\"name\": \"B\", \"cat\": \"match\"") == 4);
+        REQUIRE(Count(trace, "\"name\": \"A\", \"cat\": \"match\"") == 1);
+        REQUIRE(Count(trace, "\"name\": \"A\", \"cat\": \"fail\"") == 1);
+        REQUIRE(Count(trace, "{\"offset\": 0, \"end\": 2, \"depth\": 1}") == 4);
+        REQUIRE(Count(trace, "{\"offset\": 0, \"depth\": 0}") == 1);
+    }
+    SECTION("Filter by depth")
+    {
+        Tracer tracer{stream, {.max_depth = 0}};
+        context.tracer = &tracer;
+        REQUIRE(collection.Match("A", "aby", context) == 3);
+        tracer.Finish();
+        REQUIRE(Count(stream.str(), "\"ph\": \"X\"") == 1);
+        REQUIRE(Count(stream.str(), "\"name\": \"A\"") == 1);
+    }
+    SECTION("Sample calls")
+    {
+        Tracer tracer{stream, {.every = 2}};
+        context.tracer = &tracer;
+        REQUIRE(collection.Match("A", "aby", context) == 3);
+        tracer.Finish();
+        // The first and third calls, A and the second B.
+        REQUIRE(Count(stream.str(), "\"ph\": \"X\"") == 2);
+        REQUIRE(Count(stream.str(), "\"name\": \"B\"") == 1);
+        // Calls after the trace is finished are ignored.
+        REQUIRE(collection.Match("A", "aby", context) == 3);
+        REQUIRE(stream.str().ends_with("]}\n"));
+    }
+    SECTION("Reject sampling no calls")
+    {
+        REQUIRE_THROWS(Tracer{stream, {.every = 0}});
+    }
+}
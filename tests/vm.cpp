@@ -0,0 +1,187 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "helpers.hpp"
+
+#include "ast.hpp"
+#include "generator.hpp"
+#include "grammar.hpp"
+#include "vm.hpp"
+
+TEST_CASE("Compile and run program", "[VM]")
+{
+    SECTION("Compile empty program") { const auto program = vm::Compile(ast::Grammar()); }
+    SECTION("Match the closure backend on a simple grammar")
+    {
+        const auto ast = ast::Grammar(
+            ast::Definition(ast::Identifier("Number"),
+                            ast::OneOrMore(ast::Class({ast::Range("0", "9")}, {}))),
+            ast::Definition(ast::Identifier("Operator"),
+                            ast::Alternative(ast::Literal("+"), ast::Literal("**"))),
+            ast::Definition(
+                ast::Identifier("Expression"),
+                ast::Sequence(ast::Identifier("Number"),
+                              ast::ZeroOrMore(ast::Sequence(ast::Identifier("Operator"),
+                                                            ast::Identifier("Number"))),
+                              ast::Not(ast::Dot()))));
+        const auto collection = Generate(ast);
+        const auto program = vm::Compile(ast);
+
+        for (const std::string input : {"1", "12+3", "4**56+7"})
+        {
+            const auto expected = UnwrapSuccess(collection.Parse("Expression", input));
+            const auto actual = UnwrapSuccess(program.Parse("Expression", input));
+            REQUIRE(actual.position == expected.position);
+            REQUIRE(actual.node == expected.node);
+        }
+        for (const std::string input : {"", "+1", "1+", "1*2"})
+        {
+            REQUIRE_NOTHROW(UnwrapFailure(collection.Parse("Expression", input)));
+            REQUIRE_NOTHROW(UnwrapFailure(program.Parse("Expression", input)));
+        }
+    }
+    SECTION("Discard captures inside predicates")
+    {
+        const auto ast = ast::Grammar(ast::Definition(
+            ast::Identifier("Peek"),
+            ast::Sequence(ast::And(ast::Literal("ab")), ast::Literal("a"))));
+        const auto result = UnwrapSuccess(vm::Compile(ast).Parse("Peek", "ab"));
+        REQUIRE(result.position == 1);
+        const auto root = UnwrapNonTerminal(result.node[0]);
+        REQUIRE(root.children.size() == 1);
+        REQUIRE(UnwrapTerminal(root.children[0]).value == "a");
+    }
+    SECTION("Match the closure backend on shaped rules")
+    {
+        const auto ast = ast::Grammar(
+            ast::Definition(ast::Identifier("List"),
+                            ast::OneOrMore(ast::Sequence(ast::Identifier("Item"),
+                                                         ast::Identifier("Spacing")))),
+            ast::Definition(ast::Identifier("Item"),
+                            ast::Alternative(ast::Identifier("Pair"),
+                                             ast::Identifier("Word")),
+                            ast::Shape::Collapse),
+            ast::Definition(ast::Identifier("Pair"),
+                            ast::Sequence(ast::Identifier("Word"),
+                                          ast::Literal("="),
+                                          ast::Identifier("Word")),
+                            ast::Shape::Inline),
+            ast::Definition(ast::Identifier("Word"),
+                            ast::OneOrMore(ast::Range("a", "z")),
+                            ast::Shape::Token),
+            ast::Definition(ast::Identifier("Spacing"),
+                            ast::ZeroOrMore(ast::Literal(" ")),
+                            ast::Shape::Skip));
+        const auto collection = Generate(ast);
+        const auto program = vm::Compile(ast);
+        for (const std::string input : {"ab", "ab cd=ef  g", "a=b"})
+        {
+            const auto expected = UnwrapSuccess(collection.Parse("List", input));
+            REQUIRE(expected.position == input.size());
+            const auto actual = UnwrapSuccess(program.Parse("List", input));
+            REQUIRE(actual.position == expected.position);
+            REQUIRE(actual.node == expected.node);
+        }
+    }
+    SECTION("Match the closure backend on the PEG grammar")
+    {
+        const std::string input = "Expression <- Number (Plus / Minus) Number\n"
+                                  "Plus <- '+'  # addition\n"
+                                  "Minus <- !Plus '-'\n"
+                                  "Number <- [0-9]+ .?\n";
+        const auto peg = GetPegGrammarAST();
+        const auto expected = UnwrapSuccess(Generate(peg).Parse("Grammar", input));
+        const auto actual = UnwrapSuccess(vm::Compile(peg).Parse("Grammar", input));
+        REQUIRE(actual.position == input.size());
+        REQUIRE(actual.node == expected.node);
+    }
+    SECTION("Undefined rules are reported at compile time")
+    {
+        const auto ast = ast::Grammar(
+            ast::Definition(ast::Identifier("Start"), ast::Identifier("Missing")));
+        REQUIRE_THROWS(vm::Compile(ast));
+    }
+}
+
+TEST_CASE("Stream input in chunks", "[VM]")
+{
+    using enum ast::Shape;
+    const auto ast = ast::Grammar(
+        ast::Definition(ast::Identifier("List"),
+                        ast::Sequence(ast::ZeroOrMore(ast::Identifier("Item")),
+                                      ast::Not(ast::Dot()))),
+        ast::Definition(ast::Identifier("Item"),
+                        ast::Alternative(ast::Sequence(ast::Identifier("Word"),
+                                                       ast::Literal("!=")),
+                                         ast::Sequence(ast::Identifier("Word"),
+                                                       ast::Optional(ast::Literal("?"))),
+                                         ast::Identifier("Group"),
+                                         ast::Identifier("Number")),
+                        Collapse),
+        ast::Definition(ast::Identifier("Group"),
+                        ast::Sequence(ast::Literal("("),
+                                      ast::ZeroOrMore(ast::Identifier("Item")),
+                                      ast::Literal(")"))),
+        ast::Definition(ast::Identifier("Word"),
+                        ast::OneOrMore(ast::Class({ast::Range("a", "z")}, {}))),
+        ast::Definition(ast::Identifier("Number"),
+                        ast::Sequence(ast::Identifier("Digits"),
+                                      ast::Optional(ast::Identifier("Spacing"))),
+                        Inline),
+        ast::Definition(ast::Identifier("Digits"),
+                        ast::OneOrMore(ast::Class({ast::Range("0", "9")}, {})),
+                        Token),
+        ast::Definition(
+            ast::Identifier("Spacing"), ast::OneOrMore(ast::Literal(" ")), Skip));
+    const auto program = vm::Compile(ast);
+    const auto collection = Generate(ast);
+
+    for (const std::string input :
+         {"ab!=c?(de!=)", "a(b(c?)d)", "", "12 34a(5)", "ab!(c", "ab!", "(a"})
+    {
+        Recorder expected;
+        const auto end = collection.Visit("List", input, expected);
+        for (const std::size_t chunk : {1, 2, 3, 100})
+        {
+            Recorder recorder;
+            vm::Stream stream{program, "List", recorder};
+            for (std::size_t i = 0; i < input.size(); i += chunk)
+            {
+                stream.Feed(std::string_view{input}.substr(i, chunk));
+            }
+            REQUIRE(stream.Finish() == end);
+            if (end)
+            {
+                REQUIRE(recorder.text == expected.text);
+            }
+        }
+    }
+
+    SECTION("Keep only the input that can be backtracked into")
+    {
+        Recorder recorder;
+        vm::Stream stream{program, "List", recorder};
+        std::size_t buffered = 0;
+        for (int i = 0; i < 1000; i++)
+        {
+            stream.Feed("ab?");
+            stream.Feed("(12 c)");
+            buffered = std::max(buffered, stream.Buffered());
+        }
+        REQUIRE(buffered < 16);
+        REQUIRE(stream.Finish() == 9000);
+        REQUIRE(recorder.text.starts_with("(List@0 (Item@0 (Word@0 'a' 'b' Word@0-2) "));
+        REQUIRE(recorder.text.ends_with("'12' (Word@8998 'c' Word@8998-8999) ')' "
+                                        "Group@8994-9000) List@0-9000) "));
+    }
+    SECTION("Decide without the rest of the input")
+    {
+        Recorder recorder;
+        vm::Stream stream{program, "Word", recorder};
+        stream.Feed("ab");
+        stream.Feed("c1");
+        REQUIRE(recorder.text == "(Word@0 'a' 'b' 'c' Word@0-3) ");
+        stream.Feed("d");
+        REQUIRE(stream.Finish() == 3);
+        REQUIRE_THROWS(stream.Feed("e"));
+    }
+}